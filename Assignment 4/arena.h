@@ -0,0 +1,20 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// Bump allocator: allocations are carved out of large blocks and are only
+// ever released all at once.
+
+typedef struct arena_block ArenaBlock;
+
+typedef struct arena {
+    ArenaBlock *head;
+} Arena;
+
+void *arena_alloc(Arena *arena, size_t size);
+char *arena_strndup(Arena *arena, const char *s, size_t len); // Adds the NUL
+void arena_reset(Arena *arena); // Drop everything, keep one block for reuse
+void arena_free(Arena *arena);  // Drop everything and release the blocks
+
+#endif
@@ -1,149 +1,173 @@
 #include "ast.h"
+#include "intern.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-AstNode *create_string_node(const char *value) {
-    AstNode *node = malloc(sizeof(AstNode));
-    node->type = NODE_STRING;
-    node->data.string = strdup(value);
-    return node;
+// Appends a node; pointers into ast->nodes are only good until the next one
+static NodeId new_node(Ast *ast, NodeType type) {
+    if (ast->node_count == ast->node_cap) {
+        if (ast->node_cap == UINT32_MAX) {
+            fprintf(stderr, "Error: document has too many values\n");
+            exit(1);
+        }
+        NodeId cap = ast->node_cap ? ast->node_cap : 1024;
+        cap = cap > UINT32_MAX / 2 ? UINT32_MAX : cap * 2;
+        ast->nodes = realloc(ast->nodes, (size_t)cap * sizeof(AstNode));
+        if (!ast->nodes) {
+            fprintf(stderr, "Error: out of memory\n");
+            exit(1);
+        }
+        ast->node_cap = cap;
+        if (ast->node_count == 0) ast->node_count = 1; // 0 is no node
+    }
+    NodeId id = ast->node_count++;
+    AstNode *node = &ast->nodes[id];
+    node->head = type;
+    node->next = 0;
+    ast->created[type]++;
+    return id;
 }
 
-AstNode *create_number_node(double value) {
-    AstNode *node = malloc(sizeof(AstNode));
-    node->type = NODE_NUMBER;
-    node->data.number = value;
-    return node;
+// The one copy a string value gets: from the input straight into the pool
+NodeId create_string_node(Ast *ast, Lexeme value) {
+    NodeId id = new_node(ast, NODE_STRING);
+    ast->nodes[id].data.string = arena_strndup(&ast->strings, value.text, value.len);
+    return id;
 }
 
-AstNode *create_bool_node(int value) {
-    AstNode *node = malloc(sizeof(AstNode));
-    node->type = NODE_BOOL;
-    node->data.boolean = value;
-    return node;
+// Numbers keep their text, so they come out in the CSV exactly as written
+// and are only converted if something asks for the value
+NodeId create_number_node(Ast *ast, Lexeme digits) {
+    NodeId id = new_node(ast, NODE_NUMBER);
+    ast->nodes[id].data.digits = arena_strndup(&ast->strings, digits.text, digits.len);
+    return id;
 }
 
-AstNode *create_null_node(void) {
-    AstNode *node = malloc(sizeof(AstNode));
-    node->type = NODE_NULL;
-    return node;
+NodeId create_bool_node(Ast *ast, int value) {
+    NodeId id = new_node(ast, NODE_BOOL);
+    ast->nodes[id].data.boolean = value;
+    return id;
 }
 
-AstNode *create_object_node(AstNode *pairs) {
-    AstNode *node = malloc(sizeof(AstNode));
-    node->type = NODE_OBJECT;
-    node->data.pair.value = pairs;
-    return node;
+NodeId create_null_node(Ast *ast) {
+    return new_node(ast, NODE_NULL);
 }
 
-AstNode *create_array_node(AstNode *values) {
-    AstNode *node = malloc(sizeof(AstNode));
-    node->type = NODE_ARRAY;
-    node->data.array.value = values;
-    node->data.array.next = NULL;
-    return node;
+NodeId create_object_node(Ast *ast, NodeId members) {
+    NodeId id = new_node(ast, NODE_OBJECT);
+    ast->nodes[id].data.first = members;
+    return id;
 }
 
-AstNode *create_pair_node(const char *key, AstNode *value) {
-    AstNode *node = malloc(sizeof(AstNode));
-    node->type = NODE_PAIR;
-    node->data.pair.key = strdup(key);
-    node->data.pair.value = value;
-    node->data.pair.next = NULL;
-    return node;
+NodeId create_array_node(Ast *ast, NodeId values) {
+    NodeId id = new_node(ast, NODE_ARRAY);
+    ast->nodes[id].data.first = values;
+    return id;
 }
 
-AstNode *append_pair(AstNode *pair, AstNode *pairs) {
-    pair->data.pair.next = pairs;
-    return pair;
+// A value of 0 has already been consumed by the stream writer
+NodeId create_pair_node(Ast *ast, const char *key, NodeId value) {
+    if (!value) return 0;
+    AstNode *node = &ast->nodes[value];
+    node->head = node_type(node) | (uint32_t)key_id(key) << NODE_TYPE_BITS;
+    return value;
 }
 
-AstNode *append_value(AstNode *value, AstNode *values) {
-    AstNode *node = malloc(sizeof(AstNode));
-    node->type = value->type;
-    node->data = value->data;
-    node->data.array.next = values;
-    free(value);
-    return node;
+// The digits are -?[0-9]+(\.[0-9]+)?, so this is plain decimal conversion.
+// Wholes of up to 15 digits are exact in a double and skip strtod().
+double node_number(const AstNode *node) {
+    const char *p = node->data.digits;
+    const char *d = p + (*p == '-');
+    double whole = 0;
+    int n = 0;
+    while (d[n] >= '0' && d[n] <= '9') whole = whole * 10 + (d[n++] - '0');
+    if (d[n] == '\0' && n <= 15) return *p == '-' ? -whole : whole;
+    return strtod(p, NULL);
 }
 
-static AstNode *root = NULL;
-
-void set_root(AstNode *node) {
-    root = node;
+NodeList append_node(Ast *ast, NodeList list, NodeId node) {
+    if (!node) return list;
+    if (list.tail) ast->nodes[list.tail].next = node;
+    else list.head = node;
+    list.tail = node;
+    return list;
 }
 
-AstNode *get_root(void) {
-    return root;
-}
+// Nodes print_ast still has to visit; a member prints its key line first
+typedef struct print_item {
+    NodeId node;
+    int indent;
+    int member;
+} PrintItem;
 
-void print_ast(AstNode *node, int indent) {
+static void push_print(PrintItem **stack, int *depth, int *cap, NodeId node, int indent, int member) {
     if (!node) return;
-    for (int i = 0; i < indent; i++) printf("  ");
-    switch (node->type) {
-        case NODE_OBJECT:
-            printf("OBJECT\n");
-            print_ast(node->data.pair.value, indent + 1);
-            break;
-        case NODE_ARRAY:
-            printf("ARRAY\n");
-            print_ast(node->data.array.value, indent + 1);
-            break;
-        case NODE_STRING:
-            printf("STRING: \"%s\"\n", node->data.string);
-            break;
-        case NODE_NUMBER:
-            printf("NUMBER: %.2f\n", node->data.number);
-            break;
-        case NODE_BOOL:
-            printf("BOOL: %s\n", node->data.boolean ? "true" : "false");
-            break;
-        case NODE_NULL:
-            printf("NULL\n");
-            break;
-        case NODE_PAIR:
-            printf("%s:\n", node->data.pair.key);
-            print_ast(node->data.pair.value, indent + 1);
-            print_ast(node->data.pair.next, indent);
-            break;
+    if (*depth == *cap) {
+        *cap = *cap ? *cap * 2 : 64;
+        *stack = realloc(*stack, *cap * sizeof(PrintItem));
     }
+    (*stack)[(*depth)++] = (PrintItem){ node, indent, member };
 }
 
-void print_root(void) {
-    print_ast(root, 0);
-}
-
-void free_ast(AstNode *node) {
-    if (!node) return;
-    switch (node->type) {
-        case NODE_OBJECT:
-            free_ast(node->data.pair.value);
-            break;
-        case NODE_ARRAY: {
-            AstNode *value = node->data.array.value;
-            while (value) {
-                AstNode *next = value->data.array.next;
-                free_ast(value);
-                value = next;
-            }
-            break;
+// Walks an explicit stack instead of recursing, so neither deep nesting nor
+// long lists grow the C stack. A node's next sibling is pushed before its
+// children, which then print first.
+void print_ast(const Ast *ast, NodeId id, int indent) {
+    PrintItem *stack = NULL;
+    int depth = 0, cap = 0;
+    push_print(&stack, &depth, &cap, id, indent, 0);
+    while (depth > 0) {
+        PrintItem item = stack[--depth];
+        const AstNode *node = &ast->nodes[item.node];
+        indent = item.indent;
+        push_print(&stack, &depth, &cap, node->next, indent, item.member);
+
+        if (item.member) {
+            for (int i = 0; i < indent; i++) printf("  ");
+            printf("%s:\n", node_key(node));
+            indent++;
+        }
+        for (int i = 0; i < indent; i++) printf("  ");
+        switch (node_type(node)) {
+            case NODE_OBJECT:
+                printf("OBJECT\n");
+                push_print(&stack, &depth, &cap, node->data.first, indent + 1, 1);
+                break;
+            case NODE_ARRAY:
+                printf("ARRAY\n");
+                push_print(&stack, &depth, &cap, node->data.first, indent + 1, 0);
+                break;
+            case NODE_STRING:
+                printf("STRING: \"%s\"\n", node->data.string);
+                break;
+            case NODE_NUMBER:
+                printf("NUMBER: %.2f\n", node_number(node));
+                break;
+            case NODE_BOOL:
+                printf("BOOL: %s\n", node->data.boolean ? "true" : "false");
+                break;
+            case NODE_NULL:
+                printf("NULL\n");
+                break;
         }
-        case NODE_STRING:
-            if (node->data.string) free(node->data.string);
-            break;
-        case NODE_PAIR:
-            if (node->data.pair.key) free(node->data.pair.key);
-            free_ast(node->data.pair.value);
-            free_ast(node->data.pair.next);
-            break;
-        default:
-            break;
     }
-    free(node);
+    free(stack);
 }
 
-void free_root(void) {
-    free_ast(root);
-    root = NULL;
-}
\ No newline at end of file
+// Stream mode: nothing built so far is referenced any more. The node array
+// keeps its size for the values still to come.
+void reset_ast(Ast *ast) {
+    if (ast->node_count) ast->node_count = 1;
+    arena_reset(&ast->strings);
+}
+
+void free_ast(Ast *ast) {
+    free(ast->nodes);
+    ast->nodes = NULL;
+    ast->node_count = 0;
+    ast->node_cap = 0;
+    arena_free(&ast->strings);
+    ast->root = 0;
+    memset(ast->created, 0, sizeof(ast->created));
+}
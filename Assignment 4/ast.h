@@ -1,46 +1,84 @@
 #ifndef AST_H
 #define AST_H
 
+#include "arena.h"
+#include "intern.h"
+#include <stdint.h>
+
 typedef enum {
     NODE_OBJECT,
     NODE_ARRAY,
     NODE_STRING,
     NODE_NUMBER,
     NODE_BOOL,
-    NODE_NULL,
-    NODE_PAIR
+    NODE_NULL
 } NodeType;
 
+// A token's text, pointing into the scanner's input: only good until the
+// next token is read, so whatever is kept gets copied or interned
+typedef struct lexeme {
+    const char *text;
+    size_t len;
+} Lexeme;
+
+// Nodes live in one array and refer to each other by index; 0 is no node.
+// An object has no pair nodes: each member is its value node with the key
+// id in the header.
+typedef uint32_t NodeId;
+
 typedef struct ast_node {
-    NodeType type;
+    uint32_t head;          // NodeType in the low 3 bits, member key id above
+    NodeId next;            // Next member of the object or element of the array
     union {
-        struct {
-            char *key;              // Added for pair key
-            struct ast_node *value; // Pair value
-            struct ast_node *next;  // Next pair in object
-        } pair;
-        struct {
-            struct ast_node *value; // Array value
-            struct ast_node *next;  // Next value in array
-        } array;
-        char *string;
-        double number;
+        NodeId first;       // Object: first member; array: first element
+        const char *string; // From the document's string pool
+        const char *digits; // A number as written, also in the pool
         int boolean;
     } data;
 } AstNode;
 
-AstNode *create_string_node(const char *value);
-AstNode *create_number_node(double value);
-AstNode *create_bool_node(int value);
-AstNode *create_null_node(void);
-AstNode *create_object_node(AstNode *pairs);
-AstNode *create_array_node(AstNode *values);
-AstNode *create_pair_node(const char *key, AstNode *value);
-AstNode *append_pair(AstNode *pair, AstNode *pairs);
-AstNode *append_value(AstNode *value, AstNode *values);
-void set_root(AstNode *node);
-void print_root(void);
-void free_root(void);
-AstNode *get_root(void);
-
-#endif
\ No newline at end of file
+#define NODE_TYPE_BITS 3
+#define NODE_TYPES 6
+
+// A list being parsed: the tail is kept so elements are appended in order
+typedef struct node_list {
+    NodeId head;
+    NodeId tail;
+} NodeList;
+
+// A document: nodes in one growable array, strings in an arena of their own,
+// so the tree is a single allocation plus string blocks and walks over it
+// stay in contiguous memory
+typedef struct ast {
+    AstNode *nodes;
+    NodeId node_count;      // Including the unused node 0
+    NodeId node_cap;
+    Arena strings;
+    NodeId root;
+    uint64_t created[NODE_TYPES]; // Nodes made of each type, kept across resets
+} Ast;
+
+static inline NodeType node_type(const AstNode *node) {
+    return (NodeType)(node->head & ((1u << NODE_TYPE_BITS) - 1));
+}
+
+// Key of an object member, interned (see intern.h)
+static inline const char *node_key(const AstNode *node) {
+    return key_name(node->head >> NODE_TYPE_BITS);
+}
+
+NodeId create_string_node(Ast *ast, Lexeme value);
+NodeId create_number_node(Ast *ast, Lexeme digits);
+NodeId create_bool_node(Ast *ast, int value);
+NodeId create_null_node(Ast *ast);
+NodeId create_object_node(Ast *ast, NodeId members);
+NodeId create_array_node(Ast *ast, NodeId values);
+// Makes value a member called key (interned); returns it
+NodeId create_pair_node(Ast *ast, const char *key, NodeId value);
+NodeList append_node(Ast *ast, NodeList list, NodeId node);
+double node_number(const AstNode *node); // Parses the digits
+void print_ast(const Ast *ast, NodeId node, int indent);
+void reset_ast(Ast *ast);
+void free_ast(Ast *ast);
+
+#endif
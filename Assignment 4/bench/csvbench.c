@@ -0,0 +1,113 @@
+// CSV writing throughput: the buffered writer vs. one fprintf per cell.
+// Usage: csvbench <json_file> [runs]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "../context.h"
+#include "../scanner.h"
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// The writer as it was before csv.c
+static void write_csv_stdio(Table *table, const char *dir) {
+    for (; table; table = table->next) {
+        char path[256];
+        snprintf(path, sizeof(path), "%s/%s.csv", dir, table->name);
+        FILE *fp = fopen(path, "w");
+        if (!fp) {
+            fprintf(stderr, "Error opening %s\n", path);
+            exit(1);
+        }
+        int col_count = 0;
+        for (Column *c = table->columns; c; c = c->next) {
+            if (col_count > 0) fprintf(fp, ",");
+            fprintf(fp, "%s", c->name);
+            col_count++;
+        }
+        fprintf(fp, "\n");
+        char buf[21];
+        for (long r = 0; r < table->row_count; r++) {
+            for (Column *c = table->columns; c; c = c->next) {
+                const char *value = table_cell(table, c, r, buf);
+                if (c != table->columns) fprintf(fp, ",");
+                fprintf(fp, "%s", value ? value : "");
+            }
+            fprintf(fp, "\n");
+        }
+        fclose(fp);
+    }
+}
+
+// Bytes written to dir for tables
+static long output_size(Table *table, const char *dir) {
+    long total = 0;
+    for (; table; table = table->next) {
+        char path[256];
+        struct stat st;
+        snprintf(path, sizeof(path), "%s/%s.csv", dir, table->name);
+        if (stat(path, &st) == 0) total += st.st_size;
+    }
+    return total;
+}
+
+static void remove_output(Table *table, const char *dir) {
+    for (; table; table = table->next) {
+        char path[256];
+        snprintf(path, sizeof(path), "%s/%s.csv", dir, table->name);
+        remove(path);
+    }
+}
+
+// Best of several runs, in seconds
+static double run(void (*writer)(Table *, const char *), Table *tables, const char *dir, int runs) {
+    double best = 0;
+    for (int r = 0; r < runs; r++) {
+        double start = now();
+        writer(tables, dir);
+        double elapsed = now() - start;
+        if (r == 0 || elapsed < best) best = elapsed;
+    }
+    return best;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <json_file> [runs]\n", argv[0]);
+        return 1;
+    }
+    int runs = argc > 2 ? atoi(argv[2]) : 5;
+    J2RContext ctx;
+    j2r_init(&ctx);
+    ctx.scanner = scanner_open(argv[1], 0);
+    if (!ctx.scanner) {
+        fprintf(stderr, "Error opening %s\n", argv[1]);
+        return 1;
+    }
+    if (j2r_parse(&ctx, 0) != 0) return 1;
+    Table *tables = create_tables(&ctx.tables, &ctx.ast, ctx.ast.root);
+
+    char dir[] = "/tmp/csvbench.XXXXXX";
+    if (!mkdtemp(dir)) {
+        fprintf(stderr, "Error creating %s\n", dir);
+        return 1;
+    }
+    double stdio_time = run(write_csv_stdio, tables, dir, runs);
+    double csv_time = run(write_csv, tables, dir, runs);
+    double mb = output_size(tables, dir) / (1024.0 * 1024.0);
+    remove_output(tables, dir);
+    rmdir(dir);
+
+    j2r_free(&ctx);
+
+    printf("%s: %.1f MB of CSV, best of %d\n", argv[1], mb, runs);
+    printf("fprintf %8.1f MB/s\n", mb / stdio_time);
+    printf("csv.c   %8.1f MB/s\n", mb / csv_time);
+    return 0;
+}
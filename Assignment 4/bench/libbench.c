@@ -0,0 +1,110 @@
+// Per-document cost of converting in process through libjson2relcsv vs.
+// what a caller of the binary does: write the JSON to a temp file, run
+// json2relcsv on it and read the CSV files back.
+// Usage: libbench <json_file> [documents]
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "../json2relcsv.h"
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static char *read_file(const char *path, size_t *len) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return NULL;
+    fseek(fp, 0, SEEK_END);
+    *len = ftell(fp);
+    rewind(fp);
+    char *data = malloc(*len + 1);
+    if (fread(data, 1, *len, fp) != *len) *len = 0;
+    fclose(fp);
+    return data;
+}
+
+static void write_file(const char *path, const char *data, size_t len) {
+    FILE *fp = fopen(path, "wb");
+    if (!fp || fwrite(data, 1, len, fp) != len) {
+        fprintf(stderr, "Error writing %s\n", path);
+        exit(1);
+    }
+    fclose(fp);
+}
+
+// Read every file of dir back in and remove it; returns the bytes read
+static long read_back(const char *dir) {
+    long total = 0;
+    DIR *d = opendir(dir);
+    struct dirent *e;
+    while ((e = readdir(d))) {
+        if (e->d_name[0] == '.') continue;
+        char path[512];
+        size_t len;
+        snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+        free(read_file(path, &len));
+        total += len;
+        remove(path);
+    }
+    closedir(d);
+    return total;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <json_file> [documents]\n", argv[0]);
+        return 1;
+    }
+    int docs = argc > 2 ? atoi(argv[2]) : 200;
+    size_t len;
+    char *json = read_file(argv[1], &len);
+    if (!json) {
+        fprintf(stderr, "Error opening %s\n", argv[1]);
+        return 1;
+    }
+
+    char error[128];
+    double start = now();
+    for (int i = 0; i < docs; i++) {
+        Table *tables;
+        if (j2r_convert(json, len, &tables, error, sizeof(error)) != 0) {
+            fprintf(stderr, "Error: %s\n", error);
+            return 1;
+        }
+        j2r_free_tables(tables);
+    }
+    double lib_time = (now() - start) / docs;
+
+    char dir[] = "/tmp/libbench.XXXXXX";
+    if (!mkdtemp(dir)) {
+        fprintf(stderr, "Error creating %s\n", dir);
+        return 1;
+    }
+    char input[64], out_dir[64], cmd[256];
+    snprintf(input, sizeof(input), "%s.json", dir);
+    snprintf(out_dir, sizeof(out_dir), "%s", dir);
+    snprintf(cmd, sizeof(cmd), "./json2relcsv %s --out-dir %s > /dev/null", input, out_dir);
+    start = now();
+    for (int i = 0; i < docs; i++) {
+        write_file(input, json, len);
+        if (system(cmd) != 0) {
+            fprintf(stderr, "Error running %s\n", cmd);
+            return 1;
+        }
+        read_back(out_dir);
+        remove(input);
+    }
+    double spawn_time = (now() - start) / docs;
+    rmdir(dir);
+    free(json);
+
+    printf("%s: %zu bytes, %d documents\n", argv[1], len, docs);
+    printf("json2relcsv + files %8.3f ms/document\n", spawn_time * 1e3);
+    printf("j2r_convert         %8.3f ms/document\n", lib_time * 1e3);
+    return 0;
+}
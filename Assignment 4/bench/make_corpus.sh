@@ -0,0 +1,26 @@
+#!/bin/sh
+# Usage: make_corpus.sh [MB]
+# Prints a JSON array of the valid documents under tests/ and Tests/,
+# repeated until it is at least MB megabytes (default 64).
+mb=${1:-64}
+dir=$(dirname "$0")/..
+chunk=$(mktemp)
+next=$(mktemp)
+
+sep=""
+for f in "$dir/tests/test3.json" "$dir/tests/test4.json" "$dir/tests/Test6.json" \
+         "$dir/Tests/test1.json" "$dir/Tests/test2.json"; do
+    printf '%s' "$sep" >> "$chunk"
+    cat "$f" >> "$chunk"
+    sep=","
+done
+
+while [ "$(wc -c < "$chunk")" -lt $((mb * 1024 * 1024)) ]; do
+    { cat "$chunk"; printf ','; cat "$chunk"; } > "$next"
+    mv "$next" "$chunk"
+done
+
+printf '['
+cat "$chunk"
+printf ']\n'
+rm -f "$chunk" "$next"
@@ -0,0 +1,18 @@
+#!/bin/sh
+# Usage: make_deep.sh [DEPTH]
+# Prints one JSON object nested DEPTH levels deep (default 100000). Levels
+# alternate between an object value and an array of one object, and each
+# level also has a scalar and an array of scalars.
+awk -v depth="${1:-100000}" 'BEGIN {
+    for (d = 0; d < depth; d++) {
+        printf "{\"depth\":%d,\"tags\":[\"t%d\",%d],", d, d, d
+        if (d % 2) printf "\"list\":["
+        else printf "\"next\":"
+    }
+    printf "null"
+    for (d = depth - 1; d >= 0; d--) {
+        if (d % 2) printf "]"
+        printf "}"
+    }
+    printf "\n"
+}'
@@ -0,0 +1,14 @@
+#!/bin/sh
+# Usage: make_nested.sh [DEPTH] [WIDTH]
+# Prints one JSON object nested DEPTH levels deep (default 2000) through the
+# same key, so every level is a row of one table that is still open while
+# the levels below it are added. Each level has a string of WIDTH bytes
+# (default 200) and an array of scalars.
+awk -v depth="${1:-2000}" -v width="${2:-200}" 'BEGIN {
+    pad = ""
+    for (i = 0; i < width; i++) pad = pad "x"
+    for (d = 0; d < depth; d++) printf "{\"text\":\"%s%d\",\"tags\":[%d,\"t\"],\"node\":", pad, d, d
+    printf "null"
+    for (d = 0; d < depth; d++) printf "}"
+    printf "\n"
+}'
@@ -0,0 +1,12 @@
+#!/bin/sh
+# Usage: make_tables.sh [TABLES]
+# Prints one JSON object whose TABLES keys (default 3000) each hold an
+# object with an array of scalars: a table per key, and one list table.
+awk -v tables="${1:-3000}" 'BEGIN {
+    printf "{"
+    for (t = 0; t < tables; t++) {
+        if (t > 0) printf ","
+        printf "\"t%d\":{\"n\":%d,\"list\":[%d,%d]}", t, t, t, t + 1
+    }
+    printf "}\n"
+}'
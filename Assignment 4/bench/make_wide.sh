@@ -0,0 +1,17 @@
+#!/bin/sh
+# Usage: make_wide.sh [KEYS] [ROWS]
+# Prints a JSON array of ROWS objects with KEYS scalar keys each
+# (defaults 500 and 2000).
+awk -v keys="${1:-500}" -v rows="${2:-2000}" 'BEGIN {
+    printf "[\n"
+    for (r = 0; r < rows; r++) {
+        printf "{"
+        for (k = 0; k < keys; k++) {
+            if (k > 0) printf ","
+            if (k % 2) printf "\"key_%d\":\"v%d\"", k, r
+            else printf "\"key_%d\":%d", k, r + k
+        }
+        printf "}%s\n", (r < rows - 1) ? "," : ""
+    }
+    printf "]\n"
+}'
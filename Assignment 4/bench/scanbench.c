@@ -0,0 +1,83 @@
+// Scanner throughput: FILE* input vs. the mmap input path of the flex
+// scanner, and the structural (--scanner=simd) front end with each block
+// classifier the CPU supports.
+// Usage: scanbench <json_file> [runs]
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <time.h>
+#include "../parser.h"
+#include "../scanner.h"
+#include "../structural.h"
+
+extern int j2r_yylex(YYSTYPE *lval, void *scanner);
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Best of several runs, in seconds; use_mmap -1 runs the structural scanner
+static double scan(const char *path, int use_mmap, int runs, long *tokens) {
+    double best = 0;
+    for (int r = 0; r < runs; r++) {
+        void *scanner = use_mmap < 0 ? structural_open(path) : scanner_open(path, use_mmap);
+        if (!scanner) {
+            fprintf(stderr, "Error opening %s\n", path);
+            exit(1);
+        }
+        YYSTYPE yylval;
+        long count = 0;
+        double start = now();
+        int tok;
+        while ((tok = use_mmap < 0 ? structural_lex(&yylval, scanner) : j2r_yylex(&yylval, scanner)) != 0) {
+            count++;
+        }
+        double elapsed = now() - start;
+        if (use_mmap < 0) structural_close(scanner);
+        else scanner_close(scanner);
+        if (r == 0 || elapsed < best) best = elapsed;
+        *tokens = count;
+    }
+    return best;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <json_file> [runs]\n", argv[0]);
+        return 1;
+    }
+    int runs = argc > 2 ? atoi(argv[2]) : 5;
+    struct stat st;
+    if (stat(argv[1], &st) != 0) {
+        fprintf(stderr, "Error opening %s\n", argv[1]);
+        return 1;
+    }
+    double mb = st.st_size / (1024.0 * 1024.0);
+
+    long file_tokens, mmap_tokens;
+    double file_time = scan(argv[1], 0, runs, &file_tokens);
+    double mmap_time = scan(argv[1], 1, runs, &mmap_tokens);
+    if (file_tokens != mmap_tokens) {
+        fprintf(stderr, "Token count mismatch: %ld vs %ld\n", file_tokens, mmap_tokens);
+        return 1;
+    }
+
+    printf("%s: %.1f MB, %ld tokens, best of %d\n", argv[1], mb, file_tokens, runs);
+    printf("FILE*  %8.1f MB/s\n", mb / file_time);
+    printf("mmap   %8.1f MB/s\n", mb / mmap_time);
+
+    const char *kernels[] = { "avx2", "sse2", "scalar" };
+    for (int k = 0; k < 3; k++) {
+        if (structural_set_kernel(kernels[k]) != 0) continue;
+        long simd_tokens;
+        double simd_time = scan(argv[1], -1, runs, &simd_tokens);
+        if (simd_tokens != file_tokens) {
+            fprintf(stderr, "Token count mismatch: %ld vs %ld (%s)\n", file_tokens, simd_tokens, kernels[k]);
+            return 1;
+        }
+        printf("simd   %8.1f MB/s  (%s)\n", mb / simd_time, kernels[k]);
+    }
+    return 0;
+}
@@ -0,0 +1,87 @@
+// Table building time on an already parsed document, with the size of its
+// AST, the time to visit every node and the heap the tables take.
+// Usage: tablebench <json_file> [runs]
+#include <stdio.h>
+#include <malloc.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <time.h>
+#include "../context.h"
+#include "../scanner.h"
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Depth-first over every node, the way create_tables moves through the tree
+static long walk(const Ast *ast) {
+    NodeId *stack = malloc(64 * sizeof(NodeId));
+    int depth = 0, cap = 64;
+    long visited = 0;
+    if (ast->root) stack[depth++] = ast->root;
+    while (depth > 0) {
+        const AstNode *node = &ast->nodes[stack[--depth]];
+        visited++;
+        if (node->next) stack[depth++] = node->next;
+        if ((node_type(node) == NODE_OBJECT || node_type(node) == NODE_ARRAY) && node->data.first) {
+            stack[depth++] = node->data.first;
+        }
+        if (depth + 2 > cap) {
+            cap *= 2;
+            stack = realloc(stack, cap * sizeof(NodeId));
+        }
+    }
+    free(stack);
+    return visited;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <json_file> [runs]\n", argv[0]);
+        return 1;
+    }
+    int runs = argc > 2 ? atoi(argv[2]) : 5;
+    J2RContext ctx;
+    j2r_init(&ctx);
+    ctx.scanner = scanner_open(argv[1], 0);
+    if (!ctx.scanner) {
+        fprintf(stderr, "Error opening %s\n", argv[1]);
+        return 1;
+    }
+    if (j2r_parse(&ctx, 0) != 0) return 1;
+
+    double best = 0;
+    long nodes = 0;
+    for (int r = 0; r < runs; r++) {
+        double start = now();
+        nodes = walk(&ctx.ast);
+        double elapsed = now() - start;
+        if (r == 0 || elapsed < best) best = elapsed;
+    }
+    printf("%s: %ld nodes, %.1f MB of nodes, best of %d\n", argv[1], nodes,
+           ctx.ast.node_cap * sizeof(AstNode) / 1e6, runs);
+    printf("walk          %8.1f ms  (%.0f nodes/s)\n", best * 1e3, nodes / best);
+
+    long rows = 0;
+    size_t heap = 0;
+    for (int r = 0; r < runs; r++) {
+        size_t heap_before = mallinfo2().uordblks;
+        double start = now();
+        Table *tables = create_tables(&ctx.tables, &ctx.ast, ctx.ast.root);
+        double elapsed = now() - start;
+        if (r == 0 || elapsed < best) best = elapsed;
+        heap = mallinfo2().uordblks - heap_before;
+
+        rows = 0;
+        for (Table *t = tables; t; t = t->next) rows += t->row_count;
+        free_tables(tables);
+        catalog_clear(&ctx.tables);
+    }
+    j2r_free(&ctx);
+
+    printf("create_tables %8.1f ms  (%.0f rows/s, %ld rows)\n", best * 1e3, rows / best, rows);
+    printf("table heap    %8.1f MB  (%.0f bytes/row)\n", heap / 1e6, rows ? (double)heap / rows : 0.0);
+    return 0;
+}
@@ -0,0 +1,19 @@
+#include "context.h"
+#include "scanner.h"
+#include "structural.h"
+#include <string.h>
+
+void j2r_init(J2RContext *ctx) {
+    memset(ctx, 0, sizeof(J2RContext));
+}
+
+void j2r_free(J2RContext *ctx) {
+    stream_abort(ctx->stream);
+    ndjson_abort(ctx->ndjson);
+    free_tables(ctx->tables.head);
+    catalog_clear(&ctx->tables);
+    free_ast(&ctx->ast);
+    if (ctx->scanner && ctx->simd) structural_close(ctx->scanner);
+    else if (ctx->scanner) scanner_close(ctx->scanner);
+    j2r_init(ctx);
+}
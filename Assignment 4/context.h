@@ -0,0 +1,38 @@
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+#include "ast.h"
+#include "schema.h"
+#include "stream.h"
+#include "ndjson.h"
+#include "projection.h"
+
+// One conversion: its scanner, document, tables and writers. Contexts share
+// nothing but the interned keys (see intern.h), so several conversions can
+// run at once on different threads.
+typedef struct j2r_context {
+    void *scanner;          // From scanner_open(), or
+    int simd;               // from structural_open() (--scanner=simd)
+    Ast ast;
+    Catalog tables;         // Batch mode, filled by create_tables()
+    StreamWriter *stream;   // --stream: rows are written by the parser hooks
+    Ndjson *ndjson;         // --ndjson with --jobs: records are collected here
+    int start_token;        // Handed to the parser before the input (parser.y)
+    const Projection *projection; // --select/--exclude, or NULL for everything
+    struct token_filter *filter;  // Its state while parsing (parser.y)
+    char error[128];        // Why j2r_parse() failed
+} J2RContext;
+
+void j2r_init(J2RContext *ctx);
+// Parse the scanner's input, one value or (ndjson) a sequence of records.
+// Returns 0, or 1 on a syntax error described in ctx->error. Defined in
+// parser.y.
+int j2r_parse(J2RContext *ctx, int ndjson);
+// --two-pass: run the scanner's input through ctx->stream (a schema writer)
+// token by token, without the grammar. Syntax errors are left to the second
+// pass. Also in parser.y.
+void j2r_scan_schema(J2RContext *ctx);
+// Release everything the context holds; writers still open are aborted
+void j2r_free(J2RContext *ctx);
+
+#endif
@@ -0,0 +1,149 @@
+#include "csv.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define CSV_BUFFER_SIZE (1 << 20)
+#define CSV_SMALL_BUFFER_SIZE (1 << 16)
+
+static CsvWriter *open_writer(const char *path, int flags, size_t size) {
+    int fd = open(path, O_WRONLY | flags, 0644);
+    if (fd < 0) return NULL;
+    CsvWriter *out = malloc(sizeof(CsvWriter));
+    out->fd = fd;
+    out->path = strdup(path);
+    out->buf = malloc(size);
+    out->len = 0;
+    out->cap = size;
+    out->fields = 0;
+    out->written = 0;
+    return out;
+}
+
+CsvWriter *csv_open(const char *path) {
+    return open_writer(path, O_CREAT | O_TRUNC, CSV_BUFFER_SIZE);
+}
+
+CsvWriter *csv_append(const char *path) {
+    return open_writer(path, O_APPEND, CSV_BUFFER_SIZE);
+}
+
+CsvWriter *csv_open_small(const char *path, int append) {
+    return open_writer(path, append ? O_APPEND : O_CREAT | O_TRUNC, CSV_SMALL_BUFFER_SIZE);
+}
+
+// Write all of iov, retrying short writes
+static void write_all(CsvWriter *out, struct iovec *iov, int count) {
+    while (count > 0) {
+        ssize_t n = writev(out->fd, iov, count);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "Error writing %s\n", out->path);
+            exit(1);
+        }
+        out->written += n;
+        while (count > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+}
+
+static void flush(CsvWriter *out) {
+    struct iovec iov = { out->buf, out->len };
+    write_all(out, &iov, 1);
+    out->len = 0;
+}
+
+void csv_raw(CsvWriter *out, const char *data, size_t len) {
+    if (out->len + len <= out->cap) {
+        memcpy(out->buf + out->len, data, len);
+        out->len += len;
+        return;
+    }
+    // Too big for what is left: send the buffer and the data in one call
+    struct iovec iov[2] = { { out->buf, out->len }, { (void *)data, len } };
+    write_all(out, iov, 2);
+    out->len = 0;
+}
+
+void csv_field(CsvWriter *out, const char *value) {
+    csv_cell(out, value, value ? strlen(value) : 0);
+}
+
+void csv_cell(CsvWriter *out, const char *value, size_t len) {
+    if (out->len + len + 1 > out->cap) flush(out);
+    if (out->fields++ > 0) out->buf[out->len++] = ',';
+    if (len > 0) csv_raw(out, value, len);
+}
+
+void csv_end_row(CsvWriter *out) {
+    if (out->len == out->cap) flush(out);
+    out->buf[out->len++] = '\n';
+    out->fields = 0;
+}
+
+size_t csv_close(CsvWriter *out) {
+    if (out->len > 0) flush(out);
+    size_t written = out->written;
+    close(out->fd);
+    free(out->buf);
+    free(out->path);
+    free(out);
+    return written;
+}
+
+// Two digits per division
+static const char digit_pairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+void csv_copy_rows(CsvWriter *out, FILE *in, long rows, int missing) {
+    char *line = NULL;
+    size_t cap = 0;
+    for (long r = 0; r < rows; r++) {
+        ssize_t len = getline(&line, &cap, in);
+        if (len < 0) break;
+        if (len > 0 && line[len - 1] == '\n') len--;
+        csv_raw(out, line, len);
+        for (int i = 0; i < missing; i++) csv_raw(out, ",", 1);
+        csv_end_row(out);
+    }
+    free(line);
+}
+
+int format_int(char *buf, long value) {
+    char tmp[20];
+    unsigned long v = value < 0 ? 0UL - (unsigned long)value : (unsigned long)value;
+    char *p = tmp + sizeof(tmp);
+    while (v >= 100) {
+        const char *d = digit_pairs + v % 100 * 2;
+        v /= 100;
+        *--p = d[1];
+        *--p = d[0];
+    }
+    if (v >= 10) {
+        *--p = digit_pairs[v * 2 + 1];
+        *--p = digit_pairs[v * 2];
+    } else {
+        *--p = '0' + v;
+    }
+
+    int len = 0;
+    if (value < 0) buf[len++] = '-';
+    int n = tmp + sizeof(tmp) - p;
+    memcpy(buf + len, p, n);
+    len += n;
+    buf[len] = '\0';
+    return len;
+}
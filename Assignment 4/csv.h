@@ -0,0 +1,39 @@
+#ifndef CSV_H
+#define CSV_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+// Buffered CSV output: cells are copied into a large per-file buffer that
+// goes out with write(2) whenever it fills up. The writer adds the commas
+// and newlines itself.
+
+typedef struct csv_writer {
+    int fd;
+    char *path;
+    char *buf;
+    size_t len;
+    size_t cap;
+    int fields; // Cells on the current line so far
+    size_t written; // Bytes sent to the file
+} CsvWriter;
+
+CsvWriter *csv_open(const char *path); // NULL if the file can't be created
+CsvWriter *csv_append(const char *path); // Adds to the end of an existing file
+// Either of them with a small buffer, for files that are written a few rows
+// at a time, many of them at once
+CsvWriter *csv_open_small(const char *path, int append);
+void csv_field(CsvWriter *out, const char *value); // NULL is an empty cell
+void csv_cell(CsvWriter *out, const char *value, size_t len); // len bytes of value
+void csv_end_row(CsvWriter *out);
+void csv_raw(CsvWriter *out, const char *data, size_t len); // Bytes as they are
+size_t csv_close(CsvWriter *out); // Returns the bytes written through out
+// Copy the next rows lines of in, each followed by missing empty cells: rows
+// written before their table got more columns
+void csv_copy_rows(CsvWriter *out, FILE *in, long rows, int missing);
+
+// Decimal digits of value plus a terminating NUL; returns the length.
+// buf needs room for 21 bytes.
+int format_int(char *buf, long value);
+
+#endif
@@ -0,0 +1,129 @@
+#include "intern.h"
+#include "arena.h"
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct interned {
+    unsigned hash;
+    int id;
+    char str[];
+} Interned;
+
+// Names by id, in blocks that never move once allocated, so key_name() can
+// read them without the lock: a thread only ever holds ids that were handed
+// out under it.
+#define NAME_BLOCK_BITS 12
+#define NAME_BLOCK_SIZE (1 << NAME_BLOCK_BITS)
+#define NAME_BLOCK_COUNT (1 << 17)
+
+static Arena arena = { NULL };
+static const char **names[NAME_BLOCK_COUNT];
+static Interned **slots = NULL; // Open addressing, power-of-two size
+static size_t slot_count = 0;
+static int key_count = 0;
+static pthread_rwlock_t lock = PTHREAD_RWLOCK_INITIALIZER;
+
+static unsigned hash_key(const char *s, size_t len) {
+    unsigned h = 2166136261u; // FNV-1a
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void grow(void) {
+    size_t new_count = slot_count ? slot_count * 2 : 256;
+    Interned **new_slots = calloc(new_count, sizeof(Interned *));
+    for (size_t i = 0; i < slot_count; i++) {
+        Interned *e = slots[i];
+        if (!e) continue;
+        size_t j = e->hash & (new_count - 1);
+        while (new_slots[j]) j = (j + 1) & (new_count - 1);
+        new_slots[j] = e;
+    }
+    free(slots);
+    slots = new_slots;
+    slot_count = new_count;
+}
+
+// Slot of key, or the empty slot it would go in (i is 0 while there are no slots)
+static const char *lookup(const char *key, size_t len, unsigned h, size_t *i) {
+    *i = 0;
+    if (!slot_count) return NULL;
+    for (*i = h & (slot_count - 1); slots[*i]; *i = (*i + 1) & (slot_count - 1)) {
+        const char *str = slots[*i]->str;
+        if (slots[*i]->hash == h && strncmp(str, key, len) == 0 && str[len] == '\0') return str;
+    }
+    return NULL;
+}
+
+const char *intern_key(const char *key) {
+    return intern_key_len(key, strlen(key));
+}
+
+const char *intern_key_len(const char *key, size_t len) {
+    size_t i;
+    unsigned h = hash_key(key, len);
+    pthread_rwlock_rdlock(&lock);
+    const char *found = lookup(key, len, h, &i);
+    pthread_rwlock_unlock(&lock);
+    if (found) return found;
+
+    // New key; only this path writes. Another thread may have added it since.
+    pthread_rwlock_wrlock(&lock);
+    found = lookup(key, len, h, &i);
+    if (found) {
+        pthread_rwlock_unlock(&lock);
+        return found;
+    }
+    if ((size_t)(key_count + 1) * 10 > slot_count * 7) {
+        grow();
+        for (i = h & (slot_count - 1); slots[i]; i = (i + 1) & (slot_count - 1)) {}
+    }
+    if (key_count == NAME_BLOCK_SIZE * NAME_BLOCK_COUNT) {
+        fprintf(stderr, "Error: more than %d distinct keys\n", key_count);
+        exit(1);
+    }
+    Interned *e = arena_alloc(&arena, sizeof(Interned) + len + 1);
+    e->hash = h;
+    e->id = key_count++;
+    memcpy(e->str, key, len);
+    e->str[len] = '\0';
+    const char ***block = &names[e->id >> NAME_BLOCK_BITS];
+    if (!*block) *block = malloc(NAME_BLOCK_SIZE * sizeof(const char *));
+    (*block)[e->id & (NAME_BLOCK_SIZE - 1)] = e->str;
+    slots[i] = e;
+    pthread_rwlock_unlock(&lock);
+    return e->str;
+}
+
+int key_id(const char *key) {
+    return ((const Interned *)(key - offsetof(Interned, str)))->id;
+}
+
+const char *key_name(int id) {
+    return names[id >> NAME_BLOCK_BITS][id & (NAME_BLOCK_SIZE - 1)];
+}
+
+int interned_key_count(void) {
+    pthread_rwlock_rdlock(&lock);
+    int count = key_count;
+    pthread_rwlock_unlock(&lock);
+    return count;
+}
+
+void free_interned_keys(void) {
+    free(slots);
+    slots = NULL;
+    slot_count = 0;
+    for (int b = 0; b < NAME_BLOCK_COUNT && names[b]; b++) {
+        free(names[b]);
+        names[b] = NULL;
+    }
+    key_count = 0;
+    arena_free(&arena);
+}
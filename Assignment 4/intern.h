@@ -0,0 +1,20 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+
+// Object keys are interned: each distinct key is stored once and equal keys
+// share one pointer, so interned keys compare with ==. Every key also gets a
+// dense id (0, 1, 2, ...) that can index plain arrays.
+// The table is shared by every conversion in the process and may be used from
+// any thread; looking up a key that is already there only takes a read lock.
+// free_interned_keys() must wait until no conversion is running.
+
+const char *intern_key(const char *key);
+const char *intern_key_len(const char *key, size_t len); // key need not end in NUL
+int key_id(const char *key); // key must come from intern_key()
+const char *key_name(int id); // The interned key with that id
+int interned_key_count(void);
+void free_interned_keys(void);
+
+#endif
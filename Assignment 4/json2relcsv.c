@@ -0,0 +1,57 @@
+#include "json2relcsv.h"
+#include "context.h"
+#include "scanner.h"
+#include "intern.h"
+#include <stdio.h>
+
+static int open_buffer(J2RContext *ctx, const char *json, size_t len, char *error, size_t error_size) {
+    j2r_init(ctx);
+    ctx->scanner = scanner_open_buffer(json, len);
+    if (ctx->scanner) return 0;
+    if (error) snprintf(error, error_size, "cannot scan %zu bytes", len);
+    return 1;
+}
+
+static int parse(J2RContext *ctx, int ndjson, char *error, size_t error_size) {
+    if (j2r_parse(ctx, ndjson) == 0) return 0;
+    if (error) snprintf(error, error_size, "%s", ctx->error);
+    j2r_free(ctx);
+    return 1;
+}
+
+int j2r_convert(const char *json, size_t len, Table **tables, char *error, size_t error_size) {
+    J2RContext ctx;
+    *tables = NULL;
+    if (open_buffer(&ctx, json, len, error, error_size) != 0) return 1;
+    if (parse(&ctx, 0, error, error_size) != 0) return 1;
+
+    *tables = create_tables(&ctx.tables, &ctx.ast, ctx.ast.root);
+    catalog_clear(&ctx.tables); // the tables now belong to the caller
+    j2r_free(&ctx);
+    return 0;
+}
+
+void j2r_free_tables(Table *tables) {
+    free_tables(tables);
+}
+
+const char *j2r_table_cell(const Table *table, const Column *column, long row, char *buf) {
+    return table_cell(table, column, row, buf);
+}
+
+int j2r_stream(const char *json, size_t len, int ndjson, RowCallback on_row, void *user,
+               char *error, size_t error_size) {
+    J2RContext ctx;
+    if (open_buffer(&ctx, json, len, error, error_size) != 0) return 1;
+    ctx.stream = stream_open_callback(on_row, user, &ctx.ast);
+    if (parse(&ctx, ndjson, error, error_size) != 0) return 1;
+
+    stream_close(ctx.stream, NULL, NULL);
+    ctx.stream = NULL;
+    j2r_free(&ctx);
+    return 0;
+}
+
+void j2r_release_keys(void) {
+    free_interned_keys();
+}
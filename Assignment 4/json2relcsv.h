@@ -0,0 +1,43 @@
+#ifndef JSON2RELCSV_H
+#define JSON2RELCSV_H
+
+#include <stddef.h>
+#include "schema.h"
+
+// libjson2relcsv: the conversion without the command line or any files, for
+// documents already in memory. Calls on different threads share nothing but
+// the interned keys (see j2r_release_keys).
+//
+// Only the functions declared here are exported; the library is built with
+// hidden visibility, so its other functions can't clash with the program's.
+//
+// Both conversions return 0, or 1 when the document can't be parsed, with the
+// reason written to error (error_size bytes, may be NULL).
+
+#define J2R_API __attribute__((visibility("default")))
+
+// Build every table of a JSON document. *tables gets the first table, the
+// rest follow through next in the order json2relcsv writes its files; a
+// document without objects or arrays has none. Cells are stored by column
+// (see schema.h); read them with j2r_table_cell(). Release with
+// j2r_free_tables().
+J2R_API int j2r_convert(const char *json, size_t len, Table **tables, char *error, size_t error_size);
+J2R_API void j2r_free_tables(Table *tables);
+// Text of a cell as it goes in the CSV, NULL if empty; buf (21 bytes) holds
+// the digits of an integer
+J2R_API const char *j2r_table_cell(const Table *table, const Column *column, long row, char *buf);
+
+// Hand each row to on_row as soon as it is complete instead of keeping it,
+// like --stream (and with ndjson, --ndjson). The table and values only live
+// for the duration of the callback. Row ids match j2r_convert's. On a syntax
+// error the rows before it have already been delivered.
+J2R_API int j2r_stream(const char *json, size_t len, int ndjson, RowCallback on_row, void *user,
+                       char *error, size_t error_size);
+
+// Table and column names are interned keys, kept for the whole process so
+// that every conversion shares them. A long-running caller releases them
+// with this once no conversion is running and every table from j2r_convert
+// has been freed; the next conversion starts a new set.
+J2R_API void j2r_release_keys(void);
+
+#endif
@@ -1,51 +1,238 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include "ast.h"
-#include "schema.h"
+#include <sys/stat.h>
+#include "context.h"
+#include "scanner.h"
+#include "structural.h"
+#include "intern.h"
+#include "stats.h"
+#include "schemafile.h"
+#include "projection.h"
 
-extern int yyparse(void); // Add declaration
+// The simd scanner always maps the file, read-only
+static void *open_input(const char *filename, int simd, int use_mmap) {
+    return simd ? structural_open(filename) : scanner_open(filename, use_mmap);
+}
+
+static void close_input(void *scanner, int simd) {
+    if (simd) structural_close(scanner);
+    else scanner_close(scanner);
+}
+
+// A byte count with an optional K, M or G suffix; 0 if it isn't one
+static size_t parse_size(const char *text) {
+    char *end;
+    unsigned long long n = strtoull(text, &end, 10);
+    if (end == text) return 0;
+    switch (*end) {
+        case 'K': case 'k': n <<= 10; end++; break;
+        case 'M': case 'm': n <<= 20; end++; break;
+        case 'G': case 'g': n <<= 30; end++; break;
+    }
+    return *end == '\0' ? (size_t)n : 0;
+}
 
 int main(int argc, char *argv[]) {
     if (argc < 2) {
-        fprintf(stderr, "Usage: %s <json_file> [--print-ast] [--out-dir <dir>]\n", argv[0]);
+        fprintf(stderr, "Usage: %s <json_file> [--print-ast] [--stream] [--two-pass] [--schema <file>] [--select <paths>] [--exclude <paths>] [--ndjson] [--mmap] [--scanner=flex|simd] [--jobs <n>] [--max-memory <size>] [--stats[=json]] [--out-dir <dir>]\n", argv[0]);
         return 1;
     }
 
     const char *filename = argv[1];
     char *out_dir = ".";
-    int print_ast = 0;
+    int print_tree = 0;
+    int stream = 0;
+    int two_pass = 0;
+    const char *schema_file = NULL;
+    int use_mmap = 0;
+    int simd = 0;
+    int jobs = 1;
+    int ndjson = 0;
+    int show_stats = 0;
+    int stats_json = 0;
+    size_t max_memory = 0;
+    Projection *projection = NULL;
 
     for (int i = 2; i < argc; i++) {
         if (strcmp(argv[i], "--print-ast") == 0) {
-            print_ast = 1;
+            print_tree = 1;
+        } else if (strcmp(argv[i], "--stream") == 0) {
+            stream = 1;
+        } else if (strcmp(argv[i], "--two-pass") == 0) {
+            // Streamed, after a first pass for the tables and columns
+            two_pass = 1;
+            stream = 1;
+        } else if (strcmp(argv[i], "--schema") == 0 && i + 1 < argc) {
+            // Streamed into the tables declared in the file; no first pass
+            schema_file = argv[++i];
+            stream = 1;
+        } else if ((strcmp(argv[i], "--select") == 0 || strcmp(argv[i], "--exclude") == 0) && i + 1 < argc) {
+            // Only these paths, or all but these, are parsed
+            if (!projection) projection = projection_new();
+            int exclude = argv[i][2] == 'e';
+            if (projection_add(projection, argv[++i], exclude) != 0) {
+                fprintf(stderr, "Error: %s needs up to %d paths such as $.user.name\n",
+                        exclude ? "--exclude" : "--select", PROJECTION_MAX);
+                projection_free(projection);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--ndjson") == 0) {
+            // One record per value; records are only ever streamed
+            ndjson = 1;
+            stream = 1;
+        } else if (strcmp(argv[i], "--mmap") == 0) {
+            use_mmap = 1;
+        } else if (strncmp(argv[i], "--scanner=", 10) == 0) {
+            if (strcmp(argv[i] + 10, "simd") == 0) {
+                simd = 1;
+            } else if (strcmp(argv[i] + 10, "flex") != 0) {
+                fprintf(stderr, "Error: --scanner must be flex or simd\n");
+                projection_free(projection);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+            jobs = atoi(argv[++i]);
+            if (jobs < 1) {
+                fprintf(stderr, "Error: --jobs needs a positive number\n");
+                projection_free(projection);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--max-memory") == 0 && i + 1 < argc) {
+            max_memory = parse_size(argv[++i]);
+            if (max_memory == 0) {
+                fprintf(stderr, "Error: --max-memory needs a size such as 512M\n");
+                projection_free(projection);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            show_stats = 1;
+        } else if (strcmp(argv[i], "--stats=json") == 0) {
+            show_stats = 1;
+            stats_json = 1;
         } else if (strcmp(argv[i], "--out-dir") == 0 && i + 1 < argc) {
             out_dir = argv[++i];
         }
     }
 
-    extern FILE *yyin;
-    yyin = fopen(filename, "r");
-    if (!yyin) {
+    // The stream modes keep no AST and no tables, so these would do nothing
+    // there; of them, only --ndjson converts on several jobs
+    const char *batch_only = max_memory ? "--max-memory" : print_tree ? "--print-ast" : NULL;
+    if (stream && batch_only) {
+        fprintf(stderr, "Error: %s does not apply to --stream, --two-pass, --schema or --ndjson\n", batch_only);
+        projection_free(projection);
+        return 1;
+    }
+    if (stream && !ndjson && jobs > 1) {
+        fprintf(stderr, "Error: --jobs only applies to --ndjson among the stream modes\n");
+        projection_free(projection);
+        return 1;
+    }
+
+    // --stats: timed from here, so opening the input counts toward the parse
+    Stats stats;
+    TableCallback on_table = NULL;
+    if (show_stats) {
+        stats_start(&stats);
+        struct stat st;
+        if (stat(filename, &st) == 0) stats.bytes_in = st.st_size;
+        on_table = stats_table;
+    }
+
+    J2RContext ctx;
+    j2r_init(&ctx);
+
+    // --two-pass: learn the tables and columns, then read the input again.
+    // Both passes take the same scanner, so they see the same tokens.
+    StreamWriter *schema = NULL;
+    ctx.simd = simd;
+    ctx.projection = projection;
+    if (schema_file) {
+        Catalog declared = { 0 };
+        char error[160];
+        if (load_schema(schema_file, &declared, error, sizeof(error)) != 0) {
+            fprintf(stderr, "Error: %s: %s\n", schema_file, error);
+            free_tables(declared.head);
+            catalog_clear(&declared);
+            projection_free(projection);
+            return 1;
+        }
+        schema = stream_open_declared(&declared);
+        if (show_stats) stats_phase(&stats, PHASE_SCHEMA);
+    } else if (two_pass) {
+        ctx.scanner = open_input(filename, simd, use_mmap);
+        if (!ctx.scanner) {
+            fprintf(stderr, "Error opening %s\n", filename);
+            projection_free(projection);
+            return 1;
+        }
+        ctx.stream = stream_open_schema(&ctx.ast);
+        j2r_scan_schema(&ctx);
+        schema = ctx.stream;
+        ctx.stream = NULL;
+        close_input(ctx.scanner, simd);
+        if (show_stats) stats_phase(&stats, PHASE_SCHEMA);
+    }
+
+    ctx.scanner = open_input(filename, simd, use_mmap);
+    if (!ctx.scanner) {
         fprintf(stderr, "Error opening %s\n", filename);
+        stream_abort(schema);
+        projection_free(projection);
         return 1;
     }
 
-    if (yyparse() != 0) {
-        fclose(yyin);
+    // In stream mode rows are written while parsing and no AST is kept;
+    // NDJSON records on several jobs are kept until a chunk is converted
+    if (ndjson && jobs > 1) {
+        ctx.ndjson = ndjson_open(out_dir, jobs, &ctx.ast, schema);
+    } else if (stream) {
+        ctx.stream = stream_open(out_dir, &ctx.ast);
+        if (schema) stream_use_schema(ctx.stream, schema);
+    }
+
+    if (j2r_parse(&ctx, ndjson) != 0) {
+        fprintf(stderr, "Error: %s\n", ctx.error);
+        j2r_free(&ctx);
+        projection_free(projection);
+        free_interned_keys();
+        if (show_stats) stats_free(&stats);
         return 1;
     }
-    fclose(yyin);
+    // Printing the AST is left in the parse phase
+    if (!stream && print_tree) {
+        print_ast(&ctx.ast, ctx.ast.root, 0);
+    }
+    if (show_stats) stats_phase(&stats, PHASE_PARSE);
 
-    if (print_ast) {
-        print_root();
+    if (stream) {
+        ndjson_close(ctx.ndjson, on_table, &stats);
+        stream_close(ctx.stream, on_table, &stats);
+        ctx.ndjson = NULL;
+        ctx.stream = NULL;
+        if (show_stats) stats_phase(&stats, PHASE_WRITE);
+    } else {
+        // Rows over the budget go out to their files while tables are built
+        ctx.tables.max_memory = max_memory;
+        ctx.tables.spill_dir = out_dir;
+        Table *tables = create_tables(&ctx.tables, &ctx.ast, ctx.ast.root);
+        if (show_stats) stats_phase(&stats, PHASE_TABLES);
+        write_csv_parallel(tables, out_dir, jobs);
+        if (show_stats) {
+            stats_phase(&stats, PHASE_WRITE);
+            for (Table *t = tables; t; t = t->next) stats_table(t, &stats);
+        }
     }
 
-    Table *tables = create_tables(get_root());
-    write_csv(tables, out_dir);
-    free_tables(tables);
-    free_all_tables();
-    free_root();
+    if (show_stats) stats_nodes(&stats, &ctx.ast);
+    j2r_free(&ctx);
+    projection_free(projection);
+    free_interned_keys();
 
+    if (show_stats) {
+        stats_phase(&stats, PHASE_TEARDOWN);
+        stats_print(&stats, stderr, stats_json);
+        stats_free(&stats);
+    }
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,97 @@
+#include "ndjson.h"
+#include "stream.h"
+#include <pthread.h>
+#include <stdlib.h>
+
+// Records each job gets per chunk; a chunk's ASTs stay in memory until it
+// has been converted
+#define RECORDS_PER_JOB 1024
+
+// A contiguous run of records and the writer converting them
+typedef struct job {
+    const Ast *ast;
+    NodeId *records;
+    int count;
+    StreamWriter *writer;
+    pthread_t thread;
+} Job;
+
+struct ndjson {
+    int jobs;
+    Job *job_list;
+    NodeId *pending;
+    int pending_count;
+    StreamWriter *out;
+    Ast *ast;
+};
+
+Ndjson *ndjson_open(const char *dir, int jobs, Ast *ast, StreamWriter *schema) {
+    Ndjson *n = malloc(sizeof(Ndjson));
+    n->jobs = jobs;
+    n->job_list = malloc(jobs * sizeof(Job));
+    n->pending = malloc(jobs * RECORDS_PER_JOB * sizeof(NodeId));
+    n->pending_count = 0;
+    n->out = stream_open_records(dir);
+    if (schema) stream_use_schema(n->out, schema);
+    n->ast = ast;
+    return n;
+}
+
+static void *convert(void *arg) {
+    Job *job = arg;
+    for (int i = 0; i < job->count; i++) stream_record(job->writer, job->ast, job->records[i]);
+    return NULL;
+}
+
+// Split the pending records into one run per job, reserve each run's ids in
+// record order, convert the runs in parallel and merge them back in order
+static void convert_chunk(Ndjson *n) {
+    int per_job = (n->pending_count + n->jobs - 1) / n->jobs;
+    int used = 0;
+    for (int start = 0; start < n->pending_count; start += per_job, used++) {
+        Job *job = &n->job_list[used];
+        job->ast = n->ast;
+        job->records = n->pending + start;
+        job->count = n->pending_count - start < per_job ? n->pending_count - start : per_job;
+        int ids = 0;
+        for (int i = 0; i < job->count; i++) ids += stream_record_ids(n->out, n->ast, job->records[i]);
+        job->writer = stream_worker(n->out, stream_reserve_ids(n->out, ids));
+    }
+
+    int started = 0;
+    while (started < used && pthread_create(&n->job_list[started].thread, NULL, convert, &n->job_list[started]) == 0) {
+        started++;
+    }
+    for (int j = started; j < used; j++) convert(&n->job_list[j]); // Out of threads: do the rest here
+    for (int j = 0; j < started; j++) pthread_join(n->job_list[j].thread, NULL);
+
+    for (int j = 0; j < used; j++) stream_merge(n->out, n->job_list[j].writer);
+    n->pending_count = 0;
+    reset_ast(n->ast);
+}
+
+void ndjson_record(Ndjson *n, NodeId record) {
+    if (!n || !record) return;
+    n->pending[n->pending_count++] = record;
+    if (n->pending_count == n->jobs * RECORDS_PER_JOB) convert_chunk(n);
+}
+
+static void free_ndjson(Ndjson *n) {
+    free(n->pending);
+    free(n->job_list);
+    free(n);
+}
+
+void ndjson_close(Ndjson *n, TableCallback on_table, void *user) {
+    if (!n) return;
+    if (n->pending_count > 0) convert_chunk(n);
+    stream_close(n->out, on_table, user);
+    free_ndjson(n);
+}
+
+// Parse error: the records of the current chunk are dropped with the spools
+void ndjson_abort(Ndjson *n) {
+    if (!n) return;
+    stream_abort(n->out);
+    free_ndjson(n);
+}
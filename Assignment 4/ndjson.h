@@ -0,0 +1,22 @@
+#ifndef NDJSON_H
+#define NDJSON_H
+
+#include "ast.h"
+#include "schema.h"
+#include "stream.h"
+
+// Parallel --ndjson: records are parsed on the main thread, collected into
+// chunks and converted on up to jobs threads. The files are the same as a
+// single-threaded --ndjson run.
+
+typedef struct ndjson Ndjson;
+
+// Records are built in ast, which is reset after each chunk. With --two-pass
+// or --schema, schema has the tables (see stream_use_schema), otherwise it
+// is NULL.
+Ndjson *ndjson_open(const char *dir, int jobs, Ast *ast, StreamWriter *schema);
+void ndjson_record(Ndjson *n, NodeId record); // Called by the parser for each record; NULL n ignores it
+void ndjson_close(Ndjson *n, TableCallback on_table, void *user); // As stream_close()
+void ndjson_abort(Ndjson *n);
+
+#endif
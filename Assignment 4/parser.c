@@ -1,8 +1,8 @@
-/* A Bison parser, made by GNU Bison 3.5.1.  */
+/* A Bison parser, made by GNU Bison 3.8.2.  */
 
 /* Bison implementation for Yacc-like parsers in C
 
-   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2020 Free Software Foundation,
+   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2021 Free Software Foundation,
    Inc.
 
    This program is free software: you can redistribute it and/or modify
@@ -16,7 +16,7 @@
    GNU General Public License for more details.
 
    You should have received a copy of the GNU General Public License
-   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.  */
 
 /* As a special exception, you may create a larger work that contains
    part or all of the Bison parser skeleton and distribute that work
@@ -34,6 +34,10 @@
 /* C LALR(1) parser skeleton written by Richard Stallman, by
    simplifying the original so-called "semantic" parser.  */
 
+/* DO NOT RELY ON FEATURES THAT ARE NOT DOCUMENTED in the manual,
+   especially those whose name start with YY_ or yy_.  They are
+   private implementation details that can be changed or removed.  */
+
 /* All symbols defined below should begin with yy or YY, to avoid
    infringing on user name space.  This should be done even for local
    variables, as they might otherwise be expanded by user macros.
@@ -41,20 +45,17 @@
    define necessary library symbols; they are noted "INFRINGES ON
    USER NAME SPACE" below.  */
 
-/* Undocumented macros, especially those whose name start with YY_,
-   are private implementation details.  Do not rely on them.  */
-
-/* Identify Bison output.  */
-#define YYBISON 1
+/* Identify Bison output, and Bison version.  */
+#define YYBISON 30802
 
-/* Bison version.  */
-#define YYBISON_VERSION "3.5.1"
+/* Bison version string.  */
+#define YYBISON_VERSION "3.8.2"
 
 /* Skeleton name.  */
 #define YYSKELETON_NAME "yacc.c"
 
 /* Pure parsers.  */
-#define YYPURE 0
+#define YYPURE 2
 
 /* Push parsers.  */
 #define YYPUSH 0
@@ -62,22 +63,32 @@
 /* Pull parsers.  */
 #define YYPULL 1
 
-
-
+/* Substitute the type names.  */
+#define YYSTYPE         J2R_YYSTYPE
+/* Substitute the variable and function names.  */
+#define yyparse         j2r_yyparse
+#define yylex           j2r_yylex
+#define yyerror         j2r_yyerror
+#define yydebug         j2r_yydebug
+#define yynerrs         j2r_yynerrs
 
 /* First part of user prologue.  */
-#line 1 "parser.y"
+#line 6 "parser.y"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include "ast.h"
+#include "context.h"
+#include "scanner.h"
+#include "structural.h"
+#include "intern.h"
 
-extern int line, column;
-extern void yyerror(const char *msg);
-extern int yylex(void);
+// The parser stack is on the heap and only grows with nesting (the list
+// rules below are left-recursive), so let it go well past bison's default of
+// 10000 entries: about 30M levels, a few hundred MB of stack at most.
+#define YYMAXDEPTH 100000000
 
-#line 81 "parser.c"
+#line 92 "parser.c"
 
 # ifndef YY_CAST
 #  ifdef __cplusplus
@@ -100,71 +111,55 @@ extern int yylex(void);
 #  endif
 # endif
 
-/* Enabling verbose error messages.  */
-#ifdef YYERROR_VERBOSE
-# undef YYERROR_VERBOSE
-# define YYERROR_VERBOSE 1
-#else
-# define YYERROR_VERBOSE 0
-#endif
-
-/* Use api.header.include to #include this header
-   instead of duplicating it here.  */
-#ifndef YY_YY_PARSER_H_INCLUDED
-# define YY_YY_PARSER_H_INCLUDED
-/* Debug traces.  */
-#ifndef YYDEBUG
-# define YYDEBUG 0
-#endif
-#if YYDEBUG
-extern int yydebug;
-#endif
-
-/* Token type.  */
-#ifndef YYTOKENTYPE
-# define YYTOKENTYPE
-  enum yytokentype
-  {
-    LBRACE = 258,
-    RBRACE = 259,
-    LBRACK = 260,
-    RBRACK = 261,
-    COLON = 262,
-    COMMA = 263,
-    STRING = 264,
-    NUMBER = 265,
-    TRUE = 266,
-    FALSE = 267,
-    NULL_TOKEN = 268
-  };
-#endif
-
-/* Value type.  */
-#if ! defined YYSTYPE && ! defined YYSTYPE_IS_DECLARED
-union YYSTYPE
+#include "parser.h"
+/* Symbol kind.  */
+enum yysymbol_kind_t
 {
-#line 12 "parser.y"
-
-    char *str;
-    double num;
-    struct ast_node *node;
-
-#line 153 "parser.c"
-
+  YYSYMBOL_YYEMPTY = -2,
+  YYSYMBOL_YYEOF = 0,                      /* "end of file"  */
+  YYSYMBOL_YYerror = 1,                    /* error  */
+  YYSYMBOL_YYUNDEF = 2,                    /* "invalid token"  */
+  YYSYMBOL_LBRACE = 3,                     /* LBRACE  */
+  YYSYMBOL_RBRACE = 4,                     /* RBRACE  */
+  YYSYMBOL_LBRACK = 5,                     /* LBRACK  */
+  YYSYMBOL_RBRACK = 6,                     /* RBRACK  */
+  YYSYMBOL_COLON = 7,                      /* COLON  */
+  YYSYMBOL_COMMA = 8,                      /* COMMA  */
+  YYSYMBOL_STRING = 9,                     /* STRING  */
+  YYSYMBOL_NUMBER = 10,                    /* NUMBER  */
+  YYSYMBOL_TRUE = 11,                      /* TRUE  */
+  YYSYMBOL_FALSE = 12,                     /* FALSE  */
+  YYSYMBOL_NULL_TOKEN = 13,                /* NULL_TOKEN  */
+  YYSYMBOL_NDJSON = 14,                    /* NDJSON  */
+  YYSYMBOL_YYACCEPT = 15,                  /* $accept  */
+  YYSYMBOL_json = 16,                      /* json  */
+  YYSYMBOL_records = 17,                   /* records  */
+  YYSYMBOL_value = 18,                     /* value  */
+  YYSYMBOL_object = 19,                    /* object  */
+  YYSYMBOL_object_start = 20,              /* object_start  */
+  YYSYMBOL_pairs = 21,                     /* pairs  */
+  YYSYMBOL_pair = 22,                      /* pair  */
+  YYSYMBOL_key = 23,                       /* key  */
+  YYSYMBOL_array = 24,                     /* array  */
+  YYSYMBOL_array_start = 25,               /* array_start  */
+  YYSYMBOL_values = 26                     /* values  */
 };
-typedef union YYSTYPE YYSTYPE;
-# define YYSTYPE_IS_TRIVIAL 1
-# define YYSTYPE_IS_DECLARED 1
-#endif
+typedef enum yysymbol_kind_t yysymbol_kind_t;
 
 
-extern YYSTYPE yylval;
 
-int yyparse (void);
+/* Unqualified %code blocks.  */
+#line 28 "parser.y"
 
-#endif /* !YY_YY_PARSER_H_INCLUDED  */
+extern int j2r_yylex(YYSTYPE *lval, void *scanner);
+static void yyerror(J2RContext *ctx, const char *msg);
 
+// yyparse() reads tokens through next_token (see below)
+static int next_token(YYSTYPE *lval, J2RContext *ctx);
+#undef yylex
+#define yylex next_token
 
+#line 163 "parser.c"
 
 #ifdef short
 # undef short
@@ -203,6 +198,18 @@ typedef int_least16_t yytype_int16;
 typedef short yytype_int16;
 #endif
 
+/* Work around bug in HP-UX 11.23, which defines these macros
+   incorrectly for preprocessor constants.  This workaround can likely
+   be removed in 2023, as HPE has promised support for HP-UX 11.23
+   (aka HP-UX 11i v2) only through the end of 2022; see Table 2 of
+   <https://h20195.www2.hpe.com/V2/getpdf.aspx/4AA4-7673ENW.pdf>.  */
+#ifdef __hpux
+# undef UINT_LEAST8_MAX
+# undef UINT_LEAST16_MAX
+# define UINT_LEAST8_MAX 255
+# define UINT_LEAST16_MAX 65535
+#endif
+
 #if defined __UINT_LEAST8_MAX__ && __UINT_LEAST8_MAX__ <= __INT_MAX__
 typedef __UINT_LEAST8_TYPE__ yytype_uint8;
 #elif (!defined __UINT_LEAST8_MAX__ && defined YY_STDINT_H \
@@ -262,6 +269,7 @@ typedef int yytype_uint16;
 
 #define YYSIZEOF(X) YY_CAST (YYPTRDIFF_T, sizeof (X))
 
+
 /* Stored state numbers (used for stacks). */
 typedef yytype_int8 yy_state_t;
 
@@ -280,6 +288,7 @@ typedef int yy_state_fast_t;
 # endif
 #endif
 
+
 #ifndef YY_ATTRIBUTE_PURE
 # if defined __GNUC__ && 2 < __GNUC__ + (96 <= __GNUC_MINOR__)
 #  define YY_ATTRIBUTE_PURE __attribute__ ((__pure__))
@@ -298,17 +307,23 @@ typedef int yy_state_fast_t;
 
 /* Suppress unused-variable warnings by "using" E.  */
 #if ! defined lint || defined __GNUC__
-# define YYUSE(E) ((void) (E))
+# define YY_USE(E) ((void) (E))
 #else
-# define YYUSE(E) /* empty */
+# define YY_USE(E) /* empty */
 #endif
 
-#if defined __GNUC__ && ! defined __ICC && 407 <= __GNUC__ * 100 + __GNUC_MINOR__
 /* Suppress an incorrect diagnostic about yylval being uninitialized.  */
-# define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN                            \
+#if defined __GNUC__ && ! defined __ICC && 406 <= __GNUC__ * 100 + __GNUC_MINOR__
+# if __GNUC__ * 100 + __GNUC_MINOR__ < 407
+#  define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN                           \
+    _Pragma ("GCC diagnostic push")                                     \
+    _Pragma ("GCC diagnostic ignored \"-Wuninitialized\"")
+# else
+#  define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN                           \
     _Pragma ("GCC diagnostic push")                                     \
     _Pragma ("GCC diagnostic ignored \"-Wuninitialized\"")              \
     _Pragma ("GCC diagnostic ignored \"-Wmaybe-uninitialized\"")
+# endif
 # define YY_IGNORE_MAYBE_UNINITIALIZED_END      \
     _Pragma ("GCC diagnostic pop")
 #else
@@ -337,7 +352,7 @@ typedef int yy_state_fast_t;
 
 #define YY_ASSERT(E) ((void) (0 && (E)))
 
-#if ! defined yyoverflow || YYERROR_VERBOSE
+#if !defined yyoverflow
 
 /* The parser invokes alloca or malloc; define the necessary symbols.  */
 
@@ -402,12 +417,11 @@ void free (void *); /* INFRINGES ON USER NAME SPACE */
 #   endif
 #  endif
 # endif
-#endif /* ! defined yyoverflow || YYERROR_VERBOSE */
-
+#endif /* !defined yyoverflow */
 
 #if (! defined yyoverflow \
      && (! defined __cplusplus \
-         || (defined YYSTYPE_IS_TRIVIAL && YYSTYPE_IS_TRIVIAL)))
+         || (defined J2R_YYSTYPE_IS_TRIVIAL && J2R_YYSTYPE_IS_TRIVIAL)))
 
 /* A type that is properly aligned for any stack member.  */
 union yyalloc
@@ -466,27 +480,29 @@ union yyalloc
 #endif /* !YYCOPY_NEEDED */
 
 /* YYFINAL -- State number of the termination state.  */
-#define YYFINAL  19
+#define YYFINAL  16
 /* YYLAST -- Last index in YYTABLE.  */
-#define YYLAST   28
+#define YYLAST   43
 
 /* YYNTOKENS -- Number of terminals.  */
-#define YYNTOKENS  14
+#define YYNTOKENS  15
 /* YYNNTS -- Number of nonterminals.  */
-#define YYNNTS  8
+#define YYNNTS  12
 /* YYNRULES -- Number of rules.  */
-#define YYNRULES  18
+#define YYNRULES  24
 /* YYNSTATES -- Number of states.  */
-#define YYNSTATES  28
+#define YYNSTATES  34
 
-#define YYUNDEFTOK  2
-#define YYMAXUTOK   268
+/* YYMAXUTOK -- Last valid token kind.  */
+#define YYMAXUTOK   269
 
 
 /* YYTRANSLATE(TOKEN-NUM) -- Symbol number corresponding to TOKEN-NUM
    as returned by yylex, with out-of-bounds checking.  */
-#define YYTRANSLATE(YYX)                                                \
-  (0 <= (YYX) && (YYX) <= YYMAXUTOK ? yytranslate[YYX] : YYUNDEFTOK)
+#define YYTRANSLATE(YYX)                                \
+  (0 <= (YYX) && (YYX) <= YYMAXUTOK                     \
+   ? YY_CAST (yysymbol_kind_t, yytranslate[YYX])        \
+   : YYSYMBOL_YYUNDEF)
 
 /* YYTRANSLATE[TOKEN-NUM] -- Symbol number corresponding to TOKEN-NUM
    as returned by yylex.  */
@@ -518,40 +534,46 @@ static const yytype_int8 yytranslate[] =
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     1,     2,     3,     4,
-       5,     6,     7,     8,     9,    10,    11,    12,    13
+       5,     6,     7,     8,     9,    10,    11,    12,    13,    14
 };
 
-#if YYDEBUG
-  /* YYRLINE[YYN] -- Source line where rule number YYN was defined.  */
+#if J2R_YYDEBUG
+/* YYRLINE[YYN] -- Source line where rule number YYN was defined.  */
 static const yytype_int8 yyrline[] =
 {
-       0,    27,    27,    29,    30,    31,    32,    33,    34,    35,
-      38,    39,    42,    43,    46,    49,    50,    53,    54
+       0,    64,    64,    65,    71,    72,    75,    76,    77,    78,
+      79,    80,    81,    84,    85,    88,    92,    93,    96,   102,
+     104,   105,   108,   110,   111
 };
 #endif
 
-#if YYDEBUG || YYERROR_VERBOSE || 0
+/** Accessing symbol of state STATE.  */
+#define YY_ACCESSING_SYMBOL(State) YY_CAST (yysymbol_kind_t, yystos[State])
+
+#if J2R_YYDEBUG || 0
+/* The user-facing name of the symbol whose (internal) number is
+   YYSYMBOL.  No bounds checking.  */
+static const char *yysymbol_name (yysymbol_kind_t yysymbol) YY_ATTRIBUTE_UNUSED;
+
 /* YYTNAME[SYMBOL-NUM] -- String name of the symbol SYMBOL-NUM.
    First, the terminals, then, starting at YYNTOKENS, nonterminals.  */
 static const char *const yytname[] =
 {
-  "$end", "error", "$undefined", "LBRACE", "RBRACE", "LBRACK", "RBRACK",
-  "COLON", "COMMA", "STRING", "NUMBER", "TRUE", "FALSE", "NULL_TOKEN",
-  "$accept", "json", "value", "object", "pairs", "pair", "array", "values", YY_NULLPTR
+  "\"end of file\"", "error", "\"invalid token\"", "LBRACE", "RBRACE",
+  "LBRACK", "RBRACK", "COLON", "COMMA", "STRING", "NUMBER", "TRUE",
+  "FALSE", "NULL_TOKEN", "NDJSON", "$accept", "json", "records", "value",
+  "object", "object_start", "pairs", "pair", "key", "array", "array_start",
+  "values", YY_NULLPTR
 };
-#endif
 
-# ifdef YYPRINT
-/* YYTOKNUM[NUM] -- (External) token number corresponding to the
-   (internal) symbol number NUM (which must be that of a token).  */
-static const yytype_int16 yytoknum[] =
+static const char *
+yysymbol_name (yysymbol_kind_t yysymbol)
 {
-       0,   256,   257,   258,   259,   260,   261,   262,   263,   264,
-     265,   266,   267,   268
-};
-# endif
+  return yytname[yysymbol];
+}
+#endif
 
-#define YYPACT_NINF (-4)
+#define YYPACT_NINF (-15)
 
 #define yypact_value_is_default(Yyn) \
   ((Yyn) == YYPACT_NINF)
@@ -561,93 +583,105 @@ static const yytype_int16 yytoknum[] =
 #define yytable_value_is_error(Yyn) \
   0
 
-  /* YYPACT[STATE-NUM] -- Index in YYTABLE of the portion describing
-     STATE-NUM.  */
+/* YYPACT[STATE-NUM] -- Index in YYTABLE of the portion describing
+   STATE-NUM.  */
 static const yytype_int8 yypact[] =
 {
-      12,     9,    -2,    -4,    -4,    -4,    -4,    -4,     2,    -4,
-      -4,    -4,    -4,    -1,     1,     4,    -4,     6,    10,    -4,
-      12,    -4,    17,    12,    -4,    -4,    -4,    -4
+      -1,   -15,   -15,   -15,   -15,   -15,   -15,   -15,   -15,     6,
+     -15,   -15,    33,   -15,    12,    23,   -15,   -15,   -15,    35,
+     -15,     0,   -15,   -15,    -3,   -15,   -15,    10,    23,   -15,
+      23,   -15,   -15,   -15
 };
 
-  /* YYDEFACT[STATE-NUM] -- Default reduction number in state STATE-NUM.
-     Performed when YYTABLE does not specify something else to do.  Zero
-     means the default is an error.  */
+/* YYDEFACT[STATE-NUM] -- Default reduction number in state STATE-NUM.
+   Performed when YYTABLE does not specify something else to do.  Zero
+   means the default is an error.  */
 static const yytype_int8 yydefact[] =
 {
-       0,     0,     0,     5,     6,     7,     8,     9,     0,     2,
-       3,     4,    11,     0,     0,    12,    16,    17,     0,     1,
-       0,    10,     0,     0,    15,    14,    13,    18
+       0,    15,    22,     8,     9,    10,    11,    12,     4,     0,
+       2,     6,     0,     7,     0,     3,     1,    14,    19,     0,
+      16,     0,    21,    23,     0,     5,    13,     0,     0,    20,
+       0,    17,    18,    24
 };
 
-  /* YYPGOTO[NTERM-NUM].  */
+/* YYPGOTO[NTERM-NUM].  */
 static const yytype_int8 yypgoto[] =
 {
-      -4,    -4,     0,    -4,    -3,    -4,    -4,     5
+     -15,   -15,   -15,   -14,   -15,   -15,   -15,    -7,   -15,   -15,
+     -15,   -15
 };
 
-  /* YYDEFGOTO[NTERM-NUM].  */
+/* YYDEFGOTO[NTERM-NUM].  */
 static const yytype_int8 yydefgoto[] =
 {
-      -1,     8,    17,    10,    14,    15,    11,    18
+       0,     9,    15,    10,    11,    12,    19,    20,    21,    13,
+      14,    24
 };
 
-  /* YYTABLE[YYPACT[STATE-NUM]] -- What to do in state STATE-NUM.  If
-     positive, shift that token.  If negative, reduce the rule whose
-     number is the opposite.  If YYTABLE_NINF, syntax error.  */
+/* YYTABLE[YYPACT[STATE-NUM]] -- What to do in state STATE-NUM.  If
+   positive, shift that token.  If negative, reduce the rule whose
+   number is the opposite.  If YYTABLE_NINF, syntax error.  */
 static const yytype_int8 yytable[] =
 {
-       9,     1,    19,     2,    16,    21,    20,     3,     4,     5,
-       6,     7,    22,    12,    23,     1,    24,     2,    13,    26,
-      25,     3,     4,     5,     6,     7,    13,     0,    27
+      23,    25,     1,    29,     2,    30,    16,    28,     3,     4,
+       5,     6,     7,     8,    32,     1,    33,     2,    22,    18,
+      31,     3,     4,     5,     6,     7,     1,     0,     2,     0,
+       0,     0,     3,     4,     5,     6,     7,    17,     0,    26,
+       0,     0,    18,    27
 };
 
 static const yytype_int8 yycheck[] =
 {
-       0,     3,     0,     5,     6,     4,     7,     9,    10,    11,
-      12,    13,     8,     4,     8,     3,     6,     5,     9,    22,
-      20,     9,    10,    11,    12,    13,     9,    -1,    23
+      14,    15,     3,     6,     5,     8,     0,     7,     9,    10,
+      11,    12,    13,    14,    28,     3,    30,     5,     6,     9,
+      27,     9,    10,    11,    12,    13,     3,    -1,     5,    -1,
+      -1,    -1,     9,    10,    11,    12,    13,     4,    -1,     4,
+      -1,    -1,     9,     8
 };
 
-  /* YYSTOS[STATE-NUM] -- The (internal number of the) accessing
-     symbol of state STATE-NUM.  */
+/* YYSTOS[STATE-NUM] -- The symbol kind of the accessing symbol of
+   state STATE-NUM.  */
 static const yytype_int8 yystos[] =
 {
-       0,     3,     5,     9,    10,    11,    12,    13,    15,    16,
-      17,    20,     4,     9,    18,    19,     6,    16,    21,     0,
-       7,     4,     8,     8,     6,    16,    18,    21
+       0,     3,     5,     9,    10,    11,    12,    13,    14,    16,
+      18,    19,    20,    24,    25,    17,     0,     4,     9,    21,
+      22,    23,     6,    18,    26,    18,     4,     8,     7,     6,
+       8,    22,    18,    18
 };
 
-  /* YYR1[YYN] -- Symbol number of symbol that rule YYN derives.  */
+/* YYR1[RULE-NUM] -- Symbol kind of the left-hand side of rule RULE-NUM.  */
 static const yytype_int8 yyr1[] =
 {
-       0,    14,    15,    16,    16,    16,    16,    16,    16,    16,
-      17,    17,    18,    18,    19,    20,    20,    21,    21
+       0,    15,    16,    16,    17,    17,    18,    18,    18,    18,
+      18,    18,    18,    19,    19,    20,    21,    21,    22,    23,
+      24,    24,    25,    26,    26
 };
 
-  /* YYR2[YYN] -- Number of symbols on the right hand side of rule YYN.  */
+/* YYR2[RULE-NUM] -- Number of symbols on the right-hand side of rule RULE-NUM.  */
 static const yytype_int8 yyr2[] =
 {
-       0,     2,     1,     1,     1,     1,     1,     1,     1,     1,
-       3,     2,     1,     3,     3,     3,     2,     1,     3
+       0,     2,     1,     2,     0,     2,     1,     1,     1,     1,
+       1,     1,     1,     3,     2,     1,     1,     3,     3,     1,
+       3,     2,     1,     1,     3
 };
 
 
+enum { YYENOMEM = -2 };
+
 #define yyerrok         (yyerrstatus = 0)
-#define yyclearin       (yychar = YYEMPTY)
-#define YYEMPTY         (-2)
-#define YYEOF           0
+#define yyclearin       (yychar = J2R_YYEMPTY)
 
 #define YYACCEPT        goto yyacceptlab
 #define YYABORT         goto yyabortlab
 #define YYERROR         goto yyerrorlab
+#define YYNOMEM         goto yyexhaustedlab
 
 
 #define YYRECOVERING()  (!!yyerrstatus)
 
 #define YYBACKUP(Token, Value)                                    \
   do                                                              \
-    if (yychar == YYEMPTY)                                        \
+    if (yychar == J2R_YYEMPTY)                                        \
       {                                                           \
         yychar = (Token);                                         \
         yylval = (Value);                                         \
@@ -657,19 +691,18 @@ static const yytype_int8 yyr2[] =
       }                                                           \
     else                                                          \
       {                                                           \
-        yyerror (YY_("syntax error: cannot back up")); \
+        yyerror (ctx, YY_("syntax error: cannot back up")); \
         YYERROR;                                                  \
       }                                                           \
   while (0)
 
-/* Error token number */
-#define YYTERROR        1
-#define YYERRCODE       256
-
+/* Backward compatibility with an undocumented macro.
+   Use J2R_YYerror or J2R_YYUNDEF. */
+#define YYERRCODE J2R_YYUNDEF
 
 
 /* Enable debugging if requested.  */
-#if YYDEBUG
+#if J2R_YYDEBUG
 
 # ifndef YYFPRINTF
 #  include <stdio.h> /* INFRINGES ON USER NAME SPACE */
@@ -682,19 +715,16 @@ do {                                            \
     YYFPRINTF Args;                             \
 } while (0)
 
-/* This macro is provided for backward compatibility. */
-#ifndef YY_LOCATION_PRINT
-# define YY_LOCATION_PRINT(File, Loc) ((void) 0)
-#endif
 
 
-# define YY_SYMBOL_PRINT(Title, Type, Value, Location)                    \
+
+# define YY_SYMBOL_PRINT(Title, Kind, Value, Location)                    \
 do {                                                                      \
   if (yydebug)                                                            \
     {                                                                     \
       YYFPRINTF (stderr, "%s ", Title);                                   \
       yy_symbol_print (stderr,                                            \
-                  Type, Value); \
+                  Kind, Value, ctx); \
       YYFPRINTF (stderr, "\n");                                           \
     }                                                                     \
 } while (0)
@@ -705,18 +735,16 @@ do {                                                                      \
 `-----------------------------------*/
 
 static void
-yy_symbol_value_print (FILE *yyo, int yytype, YYSTYPE const * const yyvaluep)
+yy_symbol_value_print (FILE *yyo,
+                       yysymbol_kind_t yykind, YYSTYPE const * const yyvaluep, J2RContext *ctx)
 {
   FILE *yyoutput = yyo;
-  YYUSE (yyoutput);
+  YY_USE (yyoutput);
+  YY_USE (ctx);
   if (!yyvaluep)
     return;
-# ifdef YYPRINT
-  if (yytype < YYNTOKENS)
-    YYPRINT (yyo, yytoknum[yytype], *yyvaluep);
-# endif
   YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
-  YYUSE (yytype);
+  YY_USE (yykind);
   YY_IGNORE_MAYBE_UNINITIALIZED_END
 }
 
@@ -726,12 +754,13 @@ yy_symbol_value_print (FILE *yyo, int yytype, YYSTYPE const * const yyvaluep)
 `---------------------------*/
 
 static void
-yy_symbol_print (FILE *yyo, int yytype, YYSTYPE const * const yyvaluep)
+yy_symbol_print (FILE *yyo,
+                 yysymbol_kind_t yykind, YYSTYPE const * const yyvaluep, J2RContext *ctx)
 {
   YYFPRINTF (yyo, "%s %s (",
-             yytype < YYNTOKENS ? "token" : "nterm", yytname[yytype]);
+             yykind < YYNTOKENS ? "token" : "nterm", yysymbol_name (yykind));
 
-  yy_symbol_value_print (yyo, yytype, yyvaluep);
+  yy_symbol_value_print (yyo, yykind, yyvaluep, ctx);
   YYFPRINTF (yyo, ")");
 }
 
@@ -764,7 +793,8 @@ do {                                                            \
 `------------------------------------------------*/
 
 static void
-yy_reduce_print (yy_state_t *yyssp, YYSTYPE *yyvsp, int yyrule)
+yy_reduce_print (yy_state_t *yyssp, YYSTYPE *yyvsp,
+                 int yyrule, J2RContext *ctx)
 {
   int yylno = yyrline[yyrule];
   int yynrhs = yyr2[yyrule];
@@ -776,9 +806,8 @@ yy_reduce_print (yy_state_t *yyssp, YYSTYPE *yyvsp, int yyrule)
     {
       YYFPRINTF (stderr, "   $%d = ", yyi + 1);
       yy_symbol_print (stderr,
-                       yystos[+yyssp[yyi + 1 - yynrhs]],
-                       &yyvsp[(yyi + 1) - (yynrhs)]
-                                              );
+                       YY_ACCESSING_SYMBOL (+yyssp[yyi + 1 - yynrhs]),
+                       &yyvsp[(yyi + 1) - (yynrhs)], ctx);
       YYFPRINTF (stderr, "\n");
     }
 }
@@ -786,18 +815,18 @@ yy_reduce_print (yy_state_t *yyssp, YYSTYPE *yyvsp, int yyrule)
 # define YY_REDUCE_PRINT(Rule)          \
 do {                                    \
   if (yydebug)                          \
-    yy_reduce_print (yyssp, yyvsp, Rule); \
+    yy_reduce_print (yyssp, yyvsp, Rule, ctx); \
 } while (0)
 
 /* Nonzero means print parse trace.  It is left uninitialized so that
    multiple parsers can coexist.  */
 int yydebug;
-#else /* !YYDEBUG */
-# define YYDPRINTF(Args)
-# define YY_SYMBOL_PRINT(Title, Type, Value, Location)
+#else /* !J2R_YYDEBUG */
+# define YYDPRINTF(Args) ((void) 0)
+# define YY_SYMBOL_PRINT(Title, Kind, Value, Location)
 # define YY_STACK_PRINT(Bottom, Top)
 # define YY_REDUCE_PRINT(Rule)
-#endif /* !YYDEBUG */
+#endif /* !J2R_YYDEBUG */
 
 
 /* YYINITDEPTH -- initial size of the parser's stacks.  */
@@ -817,265 +846,32 @@ int yydebug;
 #endif
 
 
-#if YYERROR_VERBOSE
-
-# ifndef yystrlen
-#  if defined __GLIBC__ && defined _STRING_H
-#   define yystrlen(S) (YY_CAST (YYPTRDIFF_T, strlen (S)))
-#  else
-/* Return the length of YYSTR.  */
-static YYPTRDIFF_T
-yystrlen (const char *yystr)
-{
-  YYPTRDIFF_T yylen;
-  for (yylen = 0; yystr[yylen]; yylen++)
-    continue;
-  return yylen;
-}
-#  endif
-# endif
-
-# ifndef yystpcpy
-#  if defined __GLIBC__ && defined _STRING_H && defined _GNU_SOURCE
-#   define yystpcpy stpcpy
-#  else
-/* Copy YYSRC to YYDEST, returning the address of the terminating '\0' in
-   YYDEST.  */
-static char *
-yystpcpy (char *yydest, const char *yysrc)
-{
-  char *yyd = yydest;
-  const char *yys = yysrc;
-
-  while ((*yyd++ = *yys++) != '\0')
-    continue;
-
-  return yyd - 1;
-}
-#  endif
-# endif
-
-# ifndef yytnamerr
-/* Copy to YYRES the contents of YYSTR after stripping away unnecessary
-   quotes and backslashes, so that it's suitable for yyerror.  The
-   heuristic is that double-quoting is unnecessary unless the string
-   contains an apostrophe, a comma, or backslash (other than
-   backslash-backslash).  YYSTR is taken from yytname.  If YYRES is
-   null, do not copy; instead, return the length of what the result
-   would have been.  */
-static YYPTRDIFF_T
-yytnamerr (char *yyres, const char *yystr)
-{
-  if (*yystr == '"')
-    {
-      YYPTRDIFF_T yyn = 0;
-      char const *yyp = yystr;
-
-      for (;;)
-        switch (*++yyp)
-          {
-          case '\'':
-          case ',':
-            goto do_not_strip_quotes;
-
-          case '\\':
-            if (*++yyp != '\\')
-              goto do_not_strip_quotes;
-            else
-              goto append;
-
-          append:
-          default:
-            if (yyres)
-              yyres[yyn] = *yyp;
-            yyn++;
-            break;
-
-          case '"':
-            if (yyres)
-              yyres[yyn] = '\0';
-            return yyn;
-          }
-    do_not_strip_quotes: ;
-    }
-
-  if (yyres)
-    return yystpcpy (yyres, yystr) - yyres;
-  else
-    return yystrlen (yystr);
-}
-# endif
-
-/* Copy into *YYMSG, which is of size *YYMSG_ALLOC, an error message
-   about the unexpected token YYTOKEN for the state stack whose top is
-   YYSSP.
-
-   Return 0 if *YYMSG was successfully written.  Return 1 if *YYMSG is
-   not large enough to hold the message.  In that case, also set
-   *YYMSG_ALLOC to the required number of bytes.  Return 2 if the
-   required number of bytes is too large to store.  */
-static int
-yysyntax_error (YYPTRDIFF_T *yymsg_alloc, char **yymsg,
-                yy_state_t *yyssp, int yytoken)
-{
-  enum { YYERROR_VERBOSE_ARGS_MAXIMUM = 5 };
-  /* Internationalized format string. */
-  const char *yyformat = YY_NULLPTR;
-  /* Arguments of yyformat: reported tokens (one for the "unexpected",
-     one per "expected"). */
-  char const *yyarg[YYERROR_VERBOSE_ARGS_MAXIMUM];
-  /* Actual size of YYARG. */
-  int yycount = 0;
-  /* Cumulated lengths of YYARG.  */
-  YYPTRDIFF_T yysize = 0;
-
-  /* There are many possibilities here to consider:
-     - If this state is a consistent state with a default action, then
-       the only way this function was invoked is if the default action
-       is an error action.  In that case, don't check for expected
-       tokens because there are none.
-     - The only way there can be no lookahead present (in yychar) is if
-       this state is a consistent state with a default action.  Thus,
-       detecting the absence of a lookahead is sufficient to determine
-       that there is no unexpected or expected token to report.  In that
-       case, just report a simple "syntax error".
-     - Don't assume there isn't a lookahead just because this state is a
-       consistent state with a default action.  There might have been a
-       previous inconsistent state, consistent state with a non-default
-       action, or user semantic action that manipulated yychar.
-     - Of course, the expected token list depends on states to have
-       correct lookahead information, and it depends on the parser not
-       to perform extra reductions after fetching a lookahead from the
-       scanner and before detecting a syntax error.  Thus, state merging
-       (from LALR or IELR) and default reductions corrupt the expected
-       token list.  However, the list is correct for canonical LR with
-       one exception: it will still contain any token that will not be
-       accepted due to an error action in a later state.
-  */
-  if (yytoken != YYEMPTY)
-    {
-      int yyn = yypact[+*yyssp];
-      YYPTRDIFF_T yysize0 = yytnamerr (YY_NULLPTR, yytname[yytoken]);
-      yysize = yysize0;
-      yyarg[yycount++] = yytname[yytoken];
-      if (!yypact_value_is_default (yyn))
-        {
-          /* Start YYX at -YYN if negative to avoid negative indexes in
-             YYCHECK.  In other words, skip the first -YYN actions for
-             this state because they are default actions.  */
-          int yyxbegin = yyn < 0 ? -yyn : 0;
-          /* Stay within bounds of both yycheck and yytname.  */
-          int yychecklim = YYLAST - yyn + 1;
-          int yyxend = yychecklim < YYNTOKENS ? yychecklim : YYNTOKENS;
-          int yyx;
-
-          for (yyx = yyxbegin; yyx < yyxend; ++yyx)
-            if (yycheck[yyx + yyn] == yyx && yyx != YYTERROR
-                && !yytable_value_is_error (yytable[yyx + yyn]))
-              {
-                if (yycount == YYERROR_VERBOSE_ARGS_MAXIMUM)
-                  {
-                    yycount = 1;
-                    yysize = yysize0;
-                    break;
-                  }
-                yyarg[yycount++] = yytname[yyx];
-                {
-                  YYPTRDIFF_T yysize1
-                    = yysize + yytnamerr (YY_NULLPTR, yytname[yyx]);
-                  if (yysize <= yysize1 && yysize1 <= YYSTACK_ALLOC_MAXIMUM)
-                    yysize = yysize1;
-                  else
-                    return 2;
-                }
-              }
-        }
-    }
-
-  switch (yycount)
-    {
-# define YYCASE_(N, S)                      \
-      case N:                               \
-        yyformat = S;                       \
-      break
-    default: /* Avoid compiler warnings. */
-      YYCASE_(0, YY_("syntax error"));
-      YYCASE_(1, YY_("syntax error, unexpected %s"));
-      YYCASE_(2, YY_("syntax error, unexpected %s, expecting %s"));
-      YYCASE_(3, YY_("syntax error, unexpected %s, expecting %s or %s"));
-      YYCASE_(4, YY_("syntax error, unexpected %s, expecting %s or %s or %s"));
-      YYCASE_(5, YY_("syntax error, unexpected %s, expecting %s or %s or %s or %s"));
-# undef YYCASE_
-    }
 
-  {
-    /* Don't count the "%s"s in the final size, but reserve room for
-       the terminator.  */
-    YYPTRDIFF_T yysize1 = yysize + (yystrlen (yyformat) - 2 * yycount) + 1;
-    if (yysize <= yysize1 && yysize1 <= YYSTACK_ALLOC_MAXIMUM)
-      yysize = yysize1;
-    else
-      return 2;
-  }
 
-  if (*yymsg_alloc < yysize)
-    {
-      *yymsg_alloc = 2 * yysize;
-      if (! (yysize <= *yymsg_alloc
-             && *yymsg_alloc <= YYSTACK_ALLOC_MAXIMUM))
-        *yymsg_alloc = YYSTACK_ALLOC_MAXIMUM;
-      return 1;
-    }
 
-  /* Avoid sprintf, as that infringes on the user's name space.
-     Don't have undefined behavior even if the translation
-     produced a string with the wrong number of "%s"s.  */
-  {
-    char *yyp = *yymsg;
-    int yyi = 0;
-    while ((*yyp = *yyformat) != '\0')
-      if (*yyp == '%' && yyformat[1] == 's' && yyi < yycount)
-        {
-          yyp += yytnamerr (yyp, yyarg[yyi++]);
-          yyformat += 2;
-        }
-      else
-        {
-          ++yyp;
-          ++yyformat;
-        }
-  }
-  return 0;
-}
-#endif /* YYERROR_VERBOSE */
 
 /*-----------------------------------------------.
 | Release the memory associated to this symbol.  |
 `-----------------------------------------------*/
 
 static void
-yydestruct (const char *yymsg, int yytype, YYSTYPE *yyvaluep)
+yydestruct (const char *yymsg,
+            yysymbol_kind_t yykind, YYSTYPE *yyvaluep, J2RContext *ctx)
 {
-  YYUSE (yyvaluep);
+  YY_USE (yyvaluep);
+  YY_USE (ctx);
   if (!yymsg)
     yymsg = "Deleting";
-  YY_SYMBOL_PRINT (yymsg, yytype, yyvaluep, yylocationp);
+  YY_SYMBOL_PRINT (yymsg, yykind, yyvaluep, yylocationp);
 
   YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
-  YYUSE (yytype);
+  YY_USE (yykind);
   YY_IGNORE_MAYBE_UNINITIALIZED_END
 }
 
 
 
 
-/* The lookahead symbol.  */
-int yychar;
-
-/* The semantic value of the lookahead symbol.  */
-YYSTYPE yylval;
-/* Number of syntax errors so far.  */
-int yynerrs;
 
 
 /*----------.
@@ -1083,45 +879,51 @@ int yynerrs;
 `----------*/
 
 int
-yyparse (void)
+yyparse (J2RContext *ctx)
 {
-    yy_state_fast_t yystate;
-    /* Number of tokens to shift before error messages enabled.  */
-    int yyerrstatus;
+/* Lookahead token kind.  */
+int yychar;
+
+
+/* The semantic value of the lookahead symbol.  */
+/* Default value used for initialization, for pacifying older GCCs
+   or non-GCC compilers.  */
+YY_INITIAL_VALUE (static YYSTYPE yyval_default;)
+YYSTYPE yylval YY_INITIAL_VALUE (= yyval_default);
+
+    /* Number of syntax errors so far.  */
+    int yynerrs = 0;
 
-    /* The stacks and their tools:
-       'yyss': related to states.
-       'yyvs': related to semantic values.
+    yy_state_fast_t yystate = 0;
+    /* Number of tokens to shift before error messages enabled.  */
+    int yyerrstatus = 0;
 
-       Refer to the stacks through separate pointers, to allow yyoverflow
+    /* Refer to the stacks through separate pointers, to allow yyoverflow
        to reallocate them elsewhere.  */
 
-    /* The state stack.  */
+    /* Their size.  */
+    YYPTRDIFF_T yystacksize = YYINITDEPTH;
+
+    /* The state stack: array, bottom, top.  */
     yy_state_t yyssa[YYINITDEPTH];
-    yy_state_t *yyss;
-    yy_state_t *yyssp;
+    yy_state_t *yyss = yyssa;
+    yy_state_t *yyssp = yyss;
 
-    /* The semantic value stack.  */
+    /* The semantic value stack: array, bottom, top.  */
     YYSTYPE yyvsa[YYINITDEPTH];
-    YYSTYPE *yyvs;
-    YYSTYPE *yyvsp;
-
-    YYPTRDIFF_T yystacksize;
+    YYSTYPE *yyvs = yyvsa;
+    YYSTYPE *yyvsp = yyvs;
 
   int yyn;
+  /* The return value of yyparse.  */
   int yyresult;
-  /* Lookahead token as an internal (translated) token number.  */
-  int yytoken = 0;
+  /* Lookahead symbol kind.  */
+  yysymbol_kind_t yytoken = YYSYMBOL_YYEMPTY;
   /* The variables used to return semantic value and location from the
      action routines.  */
   YYSTYPE yyval;
 
-#if YYERROR_VERBOSE
-  /* Buffer for error messages, and its allocated size.  */
-  char yymsgbuf[128];
-  char *yymsg = yymsgbuf;
-  YYPTRDIFF_T yymsg_alloc = sizeof yymsgbuf;
-#endif
+
 
 #define YYPOPSTACK(N)   (yyvsp -= (N), yyssp -= (N))
 
@@ -1129,16 +931,10 @@ yyparse (void)
      Keep to zero when no symbol should be popped.  */
   int yylen = 0;
 
-  yyssp = yyss = yyssa;
-  yyvsp = yyvs = yyvsa;
-  yystacksize = YYINITDEPTH;
-
   YYDPRINTF ((stderr, "Starting parse\n"));
 
-  yystate = 0;
-  yyerrstatus = 0;
-  yynerrs = 0;
-  yychar = YYEMPTY; /* Cause a token to be read.  */
+  yychar = J2R_YYEMPTY; /* Cause a token to be read.  */
+
   goto yysetstate;
 
 
@@ -1160,10 +956,11 @@ yysetstate:
   YY_IGNORE_USELESS_CAST_BEGIN
   *yyssp = YY_CAST (yy_state_t, yystate);
   YY_IGNORE_USELESS_CAST_END
+  YY_STACK_PRINT (yyss, yyssp);
 
   if (yyss + yystacksize - 1 <= yyssp)
 #if !defined yyoverflow && !defined YYSTACK_RELOCATE
-    goto yyexhaustedlab;
+    YYNOMEM;
 #else
     {
       /* Get the current used size of the three stacks, in elements.  */
@@ -1191,7 +988,7 @@ yysetstate:
 # else /* defined YYSTACK_RELOCATE */
       /* Extend the stack our own way.  */
       if (YYMAXDEPTH <= yystacksize)
-        goto yyexhaustedlab;
+        YYNOMEM;
       yystacksize *= 2;
       if (YYMAXDEPTH < yystacksize)
         yystacksize = YYMAXDEPTH;
@@ -1202,10 +999,10 @@ yysetstate:
           YY_CAST (union yyalloc *,
                    YYSTACK_ALLOC (YY_CAST (YYSIZE_T, YYSTACK_BYTES (yystacksize))));
         if (! yyptr)
-          goto yyexhaustedlab;
+          YYNOMEM;
         YYSTACK_RELOCATE (yyss_alloc, yyss);
         YYSTACK_RELOCATE (yyvs_alloc, yyvs);
-# undef YYSTACK_RELOCATE
+#  undef YYSTACK_RELOCATE
         if (yyss1 != yyssa)
           YYSTACK_FREE (yyss1);
       }
@@ -1224,6 +1021,7 @@ yysetstate:
     }
 #endif /* !defined yyoverflow && !defined YYSTACK_RELOCATE */
 
+
   if (yystate == YYFINAL)
     YYACCEPT;
 
@@ -1244,18 +1042,29 @@ yybackup:
 
   /* Not known => get a lookahead token if don't already have one.  */
 
-  /* YYCHAR is either YYEMPTY or YYEOF or a valid lookahead symbol.  */
-  if (yychar == YYEMPTY)
+  /* YYCHAR is either empty, or end-of-input, or a valid lookahead.  */
+  if (yychar == J2R_YYEMPTY)
     {
-      YYDPRINTF ((stderr, "Reading a token: "));
-      yychar = yylex ();
+      YYDPRINTF ((stderr, "Reading a token\n"));
+      yychar = yylex (&yylval, ctx);
     }
 
-  if (yychar <= YYEOF)
+  if (yychar <= J2R_YYEOF)
     {
-      yychar = yytoken = YYEOF;
+      yychar = J2R_YYEOF;
+      yytoken = YYSYMBOL_YYEOF;
       YYDPRINTF ((stderr, "Now at end of input.\n"));
     }
+  else if (yychar == J2R_YYerror)
+    {
+      /* The scanner already issued an error message, process directly
+         to error recovery.  But do not keep the error token as
+         lookahead, it is too special and may lead us to an endless
+         loop in error recovery. */
+      yychar = J2R_YYUNDEF;
+      yytoken = YYSYMBOL_YYerror;
+      goto yyerrlab1;
+    }
   else
     {
       yytoken = YYTRANSLATE (yychar);
@@ -1289,7 +1098,7 @@ yybackup:
   YY_IGNORE_MAYBE_UNINITIALIZED_END
 
   /* Discard the shifted token.  */
-  yychar = YYEMPTY;
+  yychar = J2R_YYEMPTY;
   goto yynewstate;
 
 
@@ -1324,98 +1133,122 @@ yyreduce:
   YY_REDUCE_PRINT (yyn);
   switch (yyn)
     {
-  case 2:
-#line 27 "parser.y"
-            { set_root((yyvsp[0].node)); }
-#line 1331 "parser.c"
+  case 2: /* json: value  */
+#line 64 "parser.y"
+            { ctx->ast.root = (yyvsp[0].node); }
+#line 1140 "parser.c"
     break;
 
-  case 5:
-#line 31 "parser.y"
-                 { (yyval.node) = create_string_node((yyvsp[0].str)); free((yyvsp[0].str)); }
-#line 1337 "parser.c"
+  case 5: /* records: records value  */
+#line 72 "parser.y"
+                       { ndjson_record(ctx->ndjson, (yyvsp[0].node)); }
+#line 1146 "parser.c"
     break;
 
-  case 6:
-#line 32 "parser.y"
-                 { (yyval.node) = create_number_node((yyvsp[0].num)); }
-#line 1343 "parser.c"
+  case 8: /* value: STRING  */
+#line 77 "parser.y"
+                 { (yyval.node) = stream_value(ctx->stream, create_string_node(&ctx->ast, (yyvsp[0].text))); }
+#line 1152 "parser.c"
     break;
 
-  case 7:
-#line 33 "parser.y"
-                 { (yyval.node) = create_bool_node(1); }
-#line 1349 "parser.c"
+  case 9: /* value: NUMBER  */
+#line 78 "parser.y"
+                 { (yyval.node) = stream_value(ctx->stream, create_number_node(&ctx->ast, (yyvsp[0].text))); }
+#line 1158 "parser.c"
     break;
 
-  case 8:
-#line 34 "parser.y"
-                 { (yyval.node) = create_bool_node(0); }
-#line 1355 "parser.c"
+  case 10: /* value: TRUE  */
+#line 79 "parser.y"
+                 { (yyval.node) = stream_value(ctx->stream, create_bool_node(&ctx->ast, 1)); }
+#line 1164 "parser.c"
     break;
 
-  case 9:
-#line 35 "parser.y"
-                  { (yyval.node) = create_null_node(); }
-#line 1361 "parser.c"
+  case 11: /* value: FALSE  */
+#line 80 "parser.y"
+                 { (yyval.node) = stream_value(ctx->stream, create_bool_node(&ctx->ast, 0)); }
+#line 1170 "parser.c"
     break;
 
-  case 10:
-#line 38 "parser.y"
-                            { (yyval.node) = create_object_node((yyvsp[-1].node)); }
-#line 1367 "parser.c"
+  case 12: /* value: NULL_TOKEN  */
+#line 81 "parser.y"
+                  { (yyval.node) = stream_value(ctx->stream, create_null_node(&ctx->ast)); }
+#line 1176 "parser.c"
     break;
 
-  case 11:
-#line 39 "parser.y"
-                            { (yyval.node) = create_object_node(NULL); }
-#line 1373 "parser.c"
+  case 13: /* object: object_start pairs RBRACE  */
+#line 84 "parser.y"
+                                  { (yyval.node) = stream_end_object(ctx->stream, create_object_node(&ctx->ast, (yyvsp[-1].list).head)); }
+#line 1182 "parser.c"
     break;
 
-  case 12:
-#line 42 "parser.y"
-                        { (yyval.node) = (yyvsp[0].node); }
-#line 1379 "parser.c"
+  case 14: /* object: object_start RBRACE  */
+#line 85 "parser.y"
+                                  { (yyval.node) = stream_end_object(ctx->stream, create_object_node(&ctx->ast, 0)); }
+#line 1188 "parser.c"
     break;
 
-  case 13:
-#line 43 "parser.y"
-                        { (yyval.node) = append_pair((yyvsp[-2].node), (yyvsp[0].node)); }
-#line 1385 "parser.c"
+  case 15: /* object_start: LBRACE  */
+#line 88 "parser.y"
+                     { stream_begin_object(ctx->stream); }
+#line 1194 "parser.c"
     break;
 
-  case 14:
-#line 46 "parser.y"
-                         { (yyval.node) = create_pair_node((yyvsp[-2].str), (yyvsp[0].node)); free((yyvsp[-2].str)); }
-#line 1391 "parser.c"
+  case 16: /* pairs: pair  */
+#line 92 "parser.y"
+                        { (yyval.list) = append_node(&ctx->ast, (NodeList){ 0, 0 }, (yyvsp[0].node)); }
+#line 1200 "parser.c"
     break;
 
-  case 15:
-#line 49 "parser.y"
-                            { (yyval.node) = create_array_node((yyvsp[-1].node)); }
-#line 1397 "parser.c"
+  case 17: /* pairs: pairs COMMA pair  */
+#line 93 "parser.y"
+                        { (yyval.list) = append_node(&ctx->ast, (yyvsp[-2].list), (yyvsp[0].node)); }
+#line 1206 "parser.c"
     break;
 
-  case 16:
-#line 50 "parser.y"
-                            { (yyval.node) = create_array_node(NULL); }
-#line 1403 "parser.c"
+  case 18: /* pair: key COLON value  */
+#line 96 "parser.y"
+                      { (yyval.node) = create_pair_node(&ctx->ast, (yyvsp[-2].key), (yyvsp[0].node)); }
+#line 1212 "parser.c"
     break;
 
-  case 17:
-#line 53 "parser.y"
-                           { (yyval.node) = (yyvsp[0].node); }
-#line 1409 "parser.c"
+  case 19: /* key: STRING  */
+#line 102 "parser.y"
+            { (yyval.key) = intern_key_len((yyvsp[0].text).text, (yyvsp[0].text).len); stream_key(ctx->stream, (yyval.key)); }
+#line 1218 "parser.c"
     break;
 
-  case 18:
-#line 54 "parser.y"
-                           { (yyval.node) = append_value((yyvsp[-2].node), (yyvsp[0].node)); }
-#line 1415 "parser.c"
+  case 20: /* array: array_start values RBRACK  */
+#line 104 "parser.y"
+                                 { (yyval.node) = stream_end_array(ctx->stream, create_array_node(&ctx->ast, (yyvsp[-1].list).head)); }
+#line 1224 "parser.c"
     break;
 
+  case 21: /* array: array_start RBRACK  */
+#line 105 "parser.y"
+                                 { (yyval.node) = stream_end_array(ctx->stream, create_array_node(&ctx->ast, 0)); }
+#line 1230 "parser.c"
+    break;
+
+  case 22: /* array_start: LBRACK  */
+#line 108 "parser.y"
+                    { stream_begin_array(ctx->stream); }
+#line 1236 "parser.c"
+    break;
+
+  case 23: /* values: value  */
+#line 110 "parser.y"
+                            { (yyval.list) = append_node(&ctx->ast, (NodeList){ 0, 0 }, (yyvsp[0].node)); }
+#line 1242 "parser.c"
+    break;
+
+  case 24: /* values: values COMMA value  */
+#line 111 "parser.y"
+                            { (yyval.list) = append_node(&ctx->ast, (yyvsp[-2].list), (yyvsp[0].node)); }
+#line 1248 "parser.c"
+    break;
 
-#line 1419 "parser.c"
+
+#line 1252 "parser.c"
 
       default: break;
     }
@@ -1430,11 +1263,10 @@ yyreduce:
      case of YYERROR or YYBACKUP, subsequent parser actions might lead
      to an incorrect destructor call or verbose syntax error message
      before the lookahead is translated.  */
-  YY_SYMBOL_PRINT ("-> $$ =", yyr1[yyn], &yyval, &yyloc);
+  YY_SYMBOL_PRINT ("-> $$ =", YY_CAST (yysymbol_kind_t, yyr1[yyn]), &yyval, &yyloc);
 
   YYPOPSTACK (yylen);
   yylen = 0;
-  YY_STACK_PRINT (yyss, yyssp);
 
   *++yyvsp = yyval;
 
@@ -1458,66 +1290,30 @@ yyreduce:
 yyerrlab:
   /* Make sure we have latest lookahead translation.  See comments at
      user semantic actions for why this is necessary.  */
-  yytoken = yychar == YYEMPTY ? YYEMPTY : YYTRANSLATE (yychar);
-
+  yytoken = yychar == J2R_YYEMPTY ? YYSYMBOL_YYEMPTY : YYTRANSLATE (yychar);
   /* If not already recovering from an error, report this error.  */
   if (!yyerrstatus)
     {
       ++yynerrs;
-#if ! YYERROR_VERBOSE
-      yyerror (YY_("syntax error"));
-#else
-# define YYSYNTAX_ERROR yysyntax_error (&yymsg_alloc, &yymsg, \
-                                        yyssp, yytoken)
-      {
-        char const *yymsgp = YY_("syntax error");
-        int yysyntax_error_status;
-        yysyntax_error_status = YYSYNTAX_ERROR;
-        if (yysyntax_error_status == 0)
-          yymsgp = yymsg;
-        else if (yysyntax_error_status == 1)
-          {
-            if (yymsg != yymsgbuf)
-              YYSTACK_FREE (yymsg);
-            yymsg = YY_CAST (char *, YYSTACK_ALLOC (YY_CAST (YYSIZE_T, yymsg_alloc)));
-            if (!yymsg)
-              {
-                yymsg = yymsgbuf;
-                yymsg_alloc = sizeof yymsgbuf;
-                yysyntax_error_status = 2;
-              }
-            else
-              {
-                yysyntax_error_status = YYSYNTAX_ERROR;
-                yymsgp = yymsg;
-              }
-          }
-        yyerror (yymsgp);
-        if (yysyntax_error_status == 2)
-          goto yyexhaustedlab;
-      }
-# undef YYSYNTAX_ERROR
-#endif
+      yyerror (ctx, YY_("syntax error"));
     }
 
-
-
   if (yyerrstatus == 3)
     {
       /* If just tried and failed to reuse lookahead token after an
          error, discard it.  */
 
-      if (yychar <= YYEOF)
+      if (yychar <= J2R_YYEOF)
         {
           /* Return failure if at end of input.  */
-          if (yychar == YYEOF)
+          if (yychar == J2R_YYEOF)
             YYABORT;
         }
       else
         {
           yydestruct ("Error: discarding",
-                      yytoken, &yylval);
-          yychar = YYEMPTY;
+                      yytoken, &yylval, ctx);
+          yychar = J2R_YYEMPTY;
         }
     }
 
@@ -1534,6 +1330,7 @@ yyerrorlab:
      label yyerrorlab therefore never appears in user code.  */
   if (0)
     YYERROR;
+  ++yynerrs;
 
   /* Do not reclaim the symbols of the rule whose action triggered
      this YYERROR.  */
@@ -1550,13 +1347,14 @@ yyerrorlab:
 yyerrlab1:
   yyerrstatus = 3;      /* Each real token shifted decrements this.  */
 
+  /* Pop stack until we find a state that shifts the error token.  */
   for (;;)
     {
       yyn = yypact[yystate];
       if (!yypact_value_is_default (yyn))
         {
-          yyn += YYTERROR;
-          if (0 <= yyn && yyn <= YYLAST && yycheck[yyn] == YYTERROR)
+          yyn += YYSYMBOL_YYerror;
+          if (0 <= yyn && yyn <= YYLAST && yycheck[yyn] == YYSYMBOL_YYerror)
             {
               yyn = yytable[yyn];
               if (0 < yyn)
@@ -1570,7 +1368,7 @@ yyerrlab1:
 
 
       yydestruct ("Error: popping",
-                  yystos[yystate], yyvsp);
+                  YY_ACCESSING_SYMBOL (yystate), yyvsp, ctx);
       YYPOPSTACK (1);
       yystate = *yyssp;
       YY_STACK_PRINT (yyss, yyssp);
@@ -1582,7 +1380,7 @@ yyerrlab1:
 
 
   /* Shift the error token.  */
-  YY_SYMBOL_PRINT ("Shifting", yystos[yyn], yyvsp, yylsp);
+  YY_SYMBOL_PRINT ("Shifting", YY_ACCESSING_SYMBOL (yyn), yyvsp, yylsp);
 
   yystate = yyn;
   goto yynewstate;
@@ -1593,7 +1391,7 @@ yyerrlab1:
 `-------------------------------------*/
 yyacceptlab:
   yyresult = 0;
-  goto yyreturn;
+  goto yyreturnlab;
 
 
 /*-----------------------------------.
@@ -1601,31 +1399,29 @@ yyacceptlab:
 `-----------------------------------*/
 yyabortlab:
   yyresult = 1;
-  goto yyreturn;
+  goto yyreturnlab;
 
 
-#if !defined yyoverflow || YYERROR_VERBOSE
-/*-------------------------------------------------.
-| yyexhaustedlab -- memory exhaustion comes here.  |
-`-------------------------------------------------*/
+/*-----------------------------------------------------------.
+| yyexhaustedlab -- YYNOMEM (memory exhaustion) comes here.  |
+`-----------------------------------------------------------*/
 yyexhaustedlab:
-  yyerror (YY_("memory exhausted"));
+  yyerror (ctx, YY_("memory exhausted"));
   yyresult = 2;
-  /* Fall through.  */
-#endif
+  goto yyreturnlab;
 
 
-/*-----------------------------------------------------.
-| yyreturn -- parsing is finished, return the result.  |
-`-----------------------------------------------------*/
-yyreturn:
-  if (yychar != YYEMPTY)
+/*----------------------------------------------------------.
+| yyreturnlab -- parsing is finished, clean up and return.  |
+`----------------------------------------------------------*/
+yyreturnlab:
+  if (yychar != J2R_YYEMPTY)
     {
       /* Make sure we have latest lookahead translation.  See comments at
          user semantic actions for why this is necessary.  */
       yytoken = YYTRANSLATE (yychar);
       yydestruct ("Cleanup: discarding lookahead",
-                  yytoken, &yylval);
+                  yytoken, &yylval, ctx);
     }
   /* Do not reclaim the symbols of the rule whose action triggered
      this YYABORT or YYACCEPT.  */
@@ -1634,23 +1430,316 @@ yyreturn:
   while (yyssp != yyss)
     {
       yydestruct ("Cleanup: popping",
-                  yystos[+*yyssp], yyvsp);
+                  YY_ACCESSING_SYMBOL (+*yyssp), yyvsp, ctx);
       YYPOPSTACK (1);
     }
 #ifndef yyoverflow
   if (yyss != yyssa)
     YYSTACK_FREE (yyss);
 #endif
-#if YYERROR_VERBOSE
-  if (yymsg != yymsgbuf)
-    YYSTACK_FREE (yymsg);
-#endif
+
   return yyresult;
 }
-#line 57 "parser.y"
 
+#line 114 "parser.y"
+
+
+static void filter_start(J2RContext *ctx);
+static void filter_end(J2RContext *ctx);
+
+int j2r_parse(J2RContext *ctx, int ndjson) {
+    ctx->start_token = ndjson ? NDJSON : 0;
+    filter_start(ctx);
+    int result = yyparse(ctx);
+    filter_end(ctx);
+    return result;
+}
+
+static int starts_value(int tok) {
+    return tok == LBRACE || tok == LBRACK || tok == NUMBER || tok == TRUE || tok == FALSE || tok == NULL_TOKEN;
+}
+
+// A string is a key when it comes first in an object or after one of its
+// commas. Every scalar value is reported as null: the schema writer only
+// needs to tell them from objects and arrays. So where a value goes, the
+// flex scanner skips a string without lexing it, unless a filter is
+// reading tokens ahead; the simd scanner has the string's end in its index.
+void j2r_scan_schema(J2RContext *ctx) {
+    char *in_object = NULL; // Per open object or array
+    int depth = 0;
+    int cap = 0;
+    int expect_key = 0;
+    int expect_value = 1;
+    int skip_strings = !ctx->simd && !ctx->projection;
+    // The nodes made here aren't the document's
+    uint64_t created[NODE_TYPES];
+    memcpy(created, ctx->ast.created, sizeof(created));
+    filter_start(ctx);
+
+    YYSTYPE lval;
+    int tok;
+    for (;;) {
+        if (skip_strings && expect_value && scanner_skip_string(ctx->scanner)) {
+            stream_value(ctx->stream, create_null_node(&ctx->ast));
+            expect_value = 0;
+            continue;
+        }
+        if ((tok = next_token(&lval, ctx)) == 0) break;
+        // The writer can't place a value without a key; the second pass
+        // stops at the same place with a syntax error
+        if (expect_key && starts_value(tok)) break;
+        expect_value = tok == COLON || tok == LBRACK || (tok == COMMA && depth > 0 && !in_object[depth - 1]);
+        switch (tok) {
+            case LBRACE:
+            case LBRACK:
+                if (depth == cap) {
+                    cap = cap ? cap * 2 : 64;
+                    in_object = realloc(in_object, cap);
+                }
+                in_object[depth++] = tok == LBRACE;
+                if (tok == LBRACE) stream_begin_object(ctx->stream);
+                else stream_begin_array(ctx->stream);
+                expect_key = tok == LBRACE;
+                break;
+            case RBRACE:
+            case RBRACK:
+                if (depth == 0) break;
+                if (in_object[--depth]) stream_end_object(ctx->stream, 0);
+                else stream_end_array(ctx->stream, 0);
+                expect_key = 0;
+                break;
+            case COMMA:
+                expect_key = depth > 0 && in_object[depth - 1];
+                break;
+            case STRING:
+                if (expect_key) {
+                    stream_key(ctx->stream, intern_key_len(lval.text.text, lval.text.len));
+                    expect_key = 0;
+                    break;
+                }
+                // fall through
+            case NUMBER:
+            case TRUE:
+            case FALSE:
+            case NULL_TOKEN:
+                stream_value(ctx->stream, create_null_node(&ctx->ast));
+                break;
+        }
+    }
+    free(in_object);
+    filter_end(ctx);
+    memcpy(ctx->ast.created, created, sizeof(created));
+}
+
+// In NDJSON mode the input is preceded by a made-up NDJSON token, which
+// picks the records rule instead of a single value
+static int raw_token(YYSTYPE *lval, J2RContext *ctx) {
+    if (ctx->start_token) {
+        int tok = ctx->start_token;
+        ctx->start_token = 0;
+        return tok;
+    }
+    if (ctx->simd) return structural_lex(lval, ctx->scanner);
+    return j2r_yylex(lval, ctx->scanner);
+}
+
+/* --select/--exclude: a filter between the scanner and the parser. A member
+   whose key isn't kept is never passed on, and the comma on one side of it
+   is dropped. Its value is read as one token, or, for an object or array,
+   skipped by the scanner up to its closing bracket without being lexed.
+   What follows a dropped member must still be a comma or a closing
+   bracket; anything else goes to the parser as an invalid token, so the
+   syntax error is where it would be without the filter. Where only some
+   paths below a key are kept, scalars are dropped too, so what is left is
+   the objects and arrays on the way to the selected keys. Tokens read
+   ahead to decide wait in a short queue. */
+typedef struct filter_frame {
+    PathState state;        // Of this object or array
+    PathState child;        // Of the value of its last kept member
+    char in_object;
+    char expect;            // The next token starts a member
+    char comma;             // Held back until the member after it is kept
+    char members;           // A member has been passed on
+    char ended;             // The last token passed on ended a value
+    char dropped;           // The last member was dropped
+} FilterFrame;
+
+struct token_filter {
+    FilterFrame *frames;    // One per open object or array
+    int depth;
+    int cap;
+    PathState root;
+    struct { int tok; YYSTYPE lval; } queue[4];
+    int queued;
+    int next;
+};
+
+static void filter_start(J2RContext *ctx) {
+    if (!ctx->projection) return;
+    ctx->filter = calloc(1, sizeof(struct token_filter));
+    ctx->filter->root = projection_root(ctx->projection);
+}
+
+static void filter_end(J2RContext *ctx) {
+    if (!ctx->filter) return;
+    free(ctx->filter->frames);
+    free(ctx->filter);
+    ctx->filter = NULL;
+}
+
+static int is_scalar(int tok) {
+    return tok == STRING || tok == NUMBER || tok == TRUE || tok == FALSE || tok == NULL_TOKEN;
+}
+
+// Follow the tokens the parser will see
+static void track(struct token_filter *f, int tok) {
+    if (tok == RBRACE || tok == RBRACK) {
+        if (f->depth > 0) f->depth--;
+        if (f->depth > 0) f->frames[f->depth - 1].ended = 1;
+        return;
+    }
+    if (tok != LBRACE && tok != LBRACK) {
+        if (f->depth > 0) f->frames[f->depth - 1].ended = is_scalar(tok);
+        return;
+    }
+    PathState state = f->root;
+    if (f->depth > 0) {
+        FilterFrame *parent = &f->frames[f->depth - 1];
+        state = parent->in_object ? parent->child : parent->state;
+    }
+    if (f->depth == f->cap) {
+        f->cap = f->cap ? f->cap * 2 : 64;
+        f->frames = realloc(f->frames, f->cap * sizeof(FilterFrame));
+    }
+    f->frames[f->depth++] = (FilterFrame){ state, state, tok == LBRACE, 1, 0, 0, 0, 0 };
+}
+
+static void enqueue(struct token_filter *f, int tok, const YYSTYPE *lval) {
+    f->queue[f->queued].tok = tok;
+    f->queue[f->queued].lval = *lval;
+    f->queued++;
+    track(f, tok);
+}
+
+static void skip_group(J2RContext *ctx) {
+    if (ctx->simd) structural_skip_group(ctx->scanner);
+    else scanner_skip_group(ctx->scanner);
+}
+
+// Decide on the member of frame starting with tok: queue its first tokens
+// and return 1, or drop it and return 0, or -1 if it has no value.
+// Anything else that isn't a member is passed on for the parser to report.
+static int keep_member(J2RContext *ctx, FilterFrame *frame, int tok, YYSTYPE *lval) {
+    struct token_filter *f = ctx->filter;
+    if (!frame->in_object) {
+        if (!frame->state.selected && is_scalar(tok)) return 0;
+        enqueue(f, tok, lval);
+        return 1;
+    }
+    if (tok != STRING) {
+        enqueue(f, tok, lval);
+        return 1;
+    }
+
+    PathState child;
+    YYSTYPE next;
+    int kept = projection_key(ctx->projection, &frame->state, lval->text.text, lval->text.len, &child);
+    if (!kept || !child.selected) {
+        // The key has to outlive the scanner's buffer, which may move
+        // while the tokens after it are read
+        if (kept) lval->text.text = intern_key_len(lval->text.text, lval->text.len);
+        else lval->text = (Lexeme){ "", 0 };
+        int colon = raw_token(&next, ctx);
+        if (colon != COLON) {
+            enqueue(f, tok, lval);
+            enqueue(f, colon, &next);
+            return 1;
+        }
+        int value = raw_token(&next, ctx);
+        if (!kept) {
+            if (value == LBRACE || value == LBRACK) skip_group(ctx);
+            else if (!is_scalar(value)) return -1;
+            return 0;
+        }
+        if (is_scalar(value)) return 0;
+        frame->child = child;
+        enqueue(f, tok, lval);
+        enqueue(f, colon, &next);
+        enqueue(f, value, &next);
+        return 1;
+    }
+    frame->child = child;
+    enqueue(f, tok, lval);
+    frame->ended = 0; // A key
+    return 1;
+}
+
+static int filter_token(YYSTYPE *lval, J2RContext *ctx) {
+    struct token_filter *f = ctx->filter;
+    for (;;) {
+        if (f->next < f->queued) {
+            *lval = f->queue[f->next].lval;
+            return f->queue[f->next++].tok;
+        }
+        f->next = f->queued = 0;
+
+        int tok = raw_token(lval, ctx);
+        FilterFrame *frame = f->depth ? &f->frames[f->depth - 1] : NULL;
+        if (frame && frame->dropped) {
+            frame->dropped = 0;
+            if (tok != COMMA && tok != RBRACE && tok != RBRACK && tok != 0) return J2R_YYUNDEF;
+        }
+        // Only a comma after a value can start a member; any other is
+        // passed on where it is, for the parser to report
+        if (!frame || (!frame->expect && (tok != COMMA || !frame->ended))) {
+            track(f, tok);
+            return tok;
+        }
+        if (!frame->expect) {
+            frame->ended = 0;
+            frame->comma = 1;
+            frame->expect = 1;
+            continue;
+        }
+        if (tok == COMMA || tok == RBRACE || tok == RBRACK || tok == 0) {
+            // Nothing to decide; a held comma goes first, so a trailing or
+            // doubled one is still a syntax error
+            int held = frame->comma;
+            frame->comma = 0;
+            frame->expect = tok == COMMA;
+            if (!held) {
+                track(f, tok);
+                return tok;
+            }
+            enqueue(f, tok, lval);
+            return COMMA;
+        }
+        frame->expect = 0;
+        int at = f->depth - 1;
+        int kept = keep_member(ctx, frame, tok, lval);
+        if (kept < 0) return J2R_YYUNDEF;
+        if (kept == 0) {
+            frame->ended = 1; // As if it had been passed on
+            frame->dropped = 1;
+            continue;
+        }
+        frame = &f->frames[at]; // Queuing a bracket may have moved it
+        int held = frame->comma && frame->members;
+        frame->comma = 0;
+        frame->members = 1;
+        if (held) return COMMA;
+    }
+}
+
+static int next_token(YYSTYPE *lval, J2RContext *ctx) {
+    if (ctx->filter) return filter_token(lval, ctx);
+    return raw_token(lval, ctx);
+}
 
-void yyerror(const char *msg) {
-    fprintf(stderr, "Error: %s at line %d, column %d\n", msg, line, column);
-    exit(1);
+// yyparse() returns 1 after this; the caller reports the error and drops
+// the partial output
+static void yyerror(J2RContext *ctx, const char *msg) {
+    int line = ctx->simd ? structural_line(ctx->scanner) : scanner_line(ctx->scanner);
+    int column = ctx->simd ? structural_column(ctx->scanner) : scanner_column(ctx->scanner);
+    snprintf(ctx->error, sizeof(ctx->error), "%s at line %d, column %d", msg, line, column);
 }
@@ -1,8 +1,8 @@
-/* A Bison parser, made by GNU Bison 3.5.1.  */
+/* A Bison parser, made by GNU Bison 3.8.2.  */
 
 /* Bison interface for Yacc-like parsers in C
 
-   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2020 Free Software Foundation,
+   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2021 Free Software Foundation,
    Inc.
 
    This program is free software: you can redistribute it and/or modify
@@ -16,7 +16,7 @@
    GNU General Public License for more details.
 
    You should have received a copy of the GNU General Public License
-   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.  */
 
 /* As a special exception, you may create a larger work that contains
    part or all of the Bison parser skeleton and distribute that work
@@ -31,59 +31,92 @@
    This special exception was added by the Free Software Foundation in
    version 2.2 of Bison.  */
 
-/* Undocumented macros, especially those whose name start with YY_,
-   are private implementation details.  Do not rely on them.  */
+/* DO NOT RELY ON FEATURES THAT ARE NOT DOCUMENTED in the manual,
+   especially those whose name start with YY_ or yy_.  They are
+   private implementation details that can be changed or removed.  */
 
-#ifndef YY_YY_PARSER_H_INCLUDED
-# define YY_YY_PARSER_H_INCLUDED
+#ifndef YY_J2R_YY_PARSER_H_INCLUDED
+# define YY_J2R_YY_PARSER_H_INCLUDED
 /* Debug traces.  */
-#ifndef YYDEBUG
-# define YYDEBUG 0
-#endif
+#ifndef J2R_YYDEBUG
+# if defined YYDEBUG
 #if YYDEBUG
-extern int yydebug;
+#   define J2R_YYDEBUG 1
+#  else
+#   define J2R_YYDEBUG 0
+#  endif
+# else /* ! defined YYDEBUG */
+#  define J2R_YYDEBUG 0
+# endif /* ! defined YYDEBUG */
+#endif  /* ! defined J2R_YYDEBUG */
+#if J2R_YYDEBUG
+extern int j2r_yydebug;
 #endif
+/* "%code requires" blocks.  */
+#line 1 "parser.y"
+
+#include "ast.h"
+typedef struct j2r_context J2RContext;
 
-/* Token type.  */
-#ifndef YYTOKENTYPE
-# define YYTOKENTYPE
-  enum yytokentype
+#line 62 "parser.h"
+
+/* Token kinds.  */
+#ifndef J2R_YYTOKENTYPE
+# define J2R_YYTOKENTYPE
+  enum j2r_yytokentype
   {
-    LBRACE = 258,
-    RBRACE = 259,
-    LBRACK = 260,
-    RBRACK = 261,
-    COLON = 262,
-    COMMA = 263,
-    STRING = 264,
-    NUMBER = 265,
-    TRUE = 266,
-    FALSE = 267,
-    NULL_TOKEN = 268
+    J2R_YYEMPTY = -2,
+    J2R_YYEOF = 0,                 /* "end of file"  */
+    J2R_YYerror = 256,             /* error  */
+    J2R_YYUNDEF = 257,             /* "invalid token"  */
+    LBRACE = 258,                  /* LBRACE  */
+    RBRACE = 259,                  /* RBRACE  */
+    LBRACK = 260,                  /* LBRACK  */
+    RBRACK = 261,                  /* RBRACK  */
+    COLON = 262,                   /* COLON  */
+    COMMA = 263,                   /* COMMA  */
+    STRING = 264,                  /* STRING  */
+    NUMBER = 265,                  /* NUMBER  */
+    TRUE = 266,                    /* TRUE  */
+    FALSE = 267,                   /* FALSE  */
+    NULL_TOKEN = 268,              /* NULL_TOKEN  */
+    NDJSON = 269                   /* NDJSON  */
   };
+  typedef enum j2r_yytokentype j2r_yytoken_kind_t;
 #endif
 
 /* Value type.  */
-#if ! defined YYSTYPE && ! defined YYSTYPE_IS_DECLARED
-union YYSTYPE
+#if ! defined J2R_YYSTYPE && ! defined J2R_YYSTYPE_IS_DECLARED
+union J2R_YYSTYPE
 {
-#line 12 "parser.y"
+#line 46 "parser.y"
 
-    char *str;
-    double num;
-    struct ast_node *node;
+    Lexeme text;
+    const char *key;
+    NodeId node;
+    NodeList list;
 
-#line 77 "parser.h"
+#line 100 "parser.h"
 
 };
-typedef union YYSTYPE YYSTYPE;
-# define YYSTYPE_IS_TRIVIAL 1
-# define YYSTYPE_IS_DECLARED 1
+typedef union J2R_YYSTYPE J2R_YYSTYPE;
+# define J2R_YYSTYPE_IS_TRIVIAL 1
+# define J2R_YYSTYPE_IS_DECLARED 1
 #endif
 
 
-extern YYSTYPE yylval;
 
-int yyparse (void);
 
-#endif /* !YY_YY_PARSER_H_INCLUDED  */
+int j2r_yyparse (J2RContext *ctx);
+
+/* "%code provides" blocks.  */
+#line 21 "parser.y"
+
+// The scanners take the value type under its unprefixed name
+#ifndef YYSTYPE
+#define YYSTYPE J2R_YYSTYPE
+#endif
+
+#line 121 "parser.h"
+
+#endif /* !YY_J2R_YY_PARSER_H_INCLUDED  */
@@ -1,62 +1,414 @@
+%code requires {
+#include "ast.h"
+typedef struct j2r_context J2RContext;
+}
+
 %{
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include "ast.h"
+#include "context.h"
+#include "scanner.h"
+#include "structural.h"
+#include "intern.h"
 
-extern int line, column;
-extern void yyerror(const char *msg);
-extern int yylex(void);
+// The parser stack is on the heap and only grows with nesting (the list
+// rules below are left-recursive), so let it go well past bison's default of
+// 10000 entries: about 30M levels, a few hundred MB of stack at most.
+#define YYMAXDEPTH 100000000
 %}
 
+%code provides {
+// The scanners take the value type under its unprefixed name
+#ifndef YYSTYPE
+#define YYSTYPE J2R_YYSTYPE
+#endif
+}
+
+%code {
+extern int j2r_yylex(YYSTYPE *lval, void *scanner);
+static void yyerror(J2RContext *ctx, const char *msg);
+
+// yyparse() reads tokens through next_token (see below)
+static int next_token(YYSTYPE *lval, J2RContext *ctx);
+#undef yylex
+#define yylex next_token
+}
+
+/* Pure parser: all of its state is on the stack or in the context, so
+   separate contexts can be parsed at the same time */
+%define api.pure full
+/* Everything bison defines starts with j2r_yy or J2R_YY, so the library
+   doesn't clash with a parser of the program it is linked into */
+%define api.prefix {j2r_yy}
+%param { J2RContext *ctx }
+
 %union {
-    char *str;
-    double num;
-    struct ast_node *node;
+    Lexeme text;
+    const char *key;
+    NodeId node;
+    NodeList list;
 }
 
 %token LBRACE RBRACE LBRACK RBRACK COLON COMMA
-%token <str> STRING
-%token <num> NUMBER
+%token <text> STRING NUMBER
 %token TRUE FALSE NULL_TOKEN
+%token NDJSON
 
-%type <node> value object array pair pairs values
+%type <node> value object array pair
+%type <list> pairs values
+%type <key> key
 
 %%
 
-json: value { set_root($1); } ;
+json: value { ctx->ast.root = $1; }
+    | NDJSON records
+    ;
+
+/* --ndjson: a sequence of top-level values, each one a record. The stream
+   writer consumes every record as it completes, or, with --jobs, the
+   record is handed to ndjson.c whole. */
+records: /* empty */
+       | records value { ndjson_record(ctx->ndjson, $2); }
+       ;
 
 value: object
      | array
-     | STRING    { $$ = create_string_node($1); free($1); }
-     | NUMBER    { $$ = create_number_node($1); }
-     | TRUE      { $$ = create_bool_node(1); }
-     | FALSE     { $$ = create_bool_node(0); }
-     | NULL_TOKEN { $$ = create_null_node(); }
+     | STRING    { $$ = stream_value(ctx->stream, create_string_node(&ctx->ast, $1)); }
+     | NUMBER    { $$ = stream_value(ctx->stream, create_number_node(&ctx->ast, $1)); }
+     | TRUE      { $$ = stream_value(ctx->stream, create_bool_node(&ctx->ast, 1)); }
+     | FALSE     { $$ = stream_value(ctx->stream, create_bool_node(&ctx->ast, 0)); }
+     | NULL_TOKEN { $$ = stream_value(ctx->stream, create_null_node(&ctx->ast)); }
      ;
 
-object: LBRACE pairs RBRACE { $$ = create_object_node($2); }
-      | LBRACE RBRACE       { $$ = create_object_node(NULL); }
+object: object_start pairs RBRACE { $$ = stream_end_object(ctx->stream, create_object_node(&ctx->ast, $2.head)); }
+      | object_start RBRACE       { $$ = stream_end_object(ctx->stream, create_object_node(&ctx->ast, 0)); }
       ;
 
-pairs: pair             { $$ = $1; }
-     | pair COMMA pairs { $$ = append_pair($1, $3); }
+object_start: LBRACE { stream_begin_object(ctx->stream); } ;
+
+/* Lists are left-recursive so the parser stack stays flat on huge arrays,
+   and carry their tail so each element is linked in place as it arrives. */
+pairs: pair             { $$ = append_node(&ctx->ast, (NodeList){ 0, 0 }, $1); }
+     | pairs COMMA pair { $$ = append_node(&ctx->ast, $1, $3); }
      ;
 
-pair: STRING COLON value { $$ = create_pair_node($1, $3); free($1); }
+pair: key COLON value { $$ = create_pair_node(&ctx->ast, $1, $3); }
     ;
 
-array: LBRACK values RBRACK { $$ = create_array_node($2); }
-     | LBRACK RBRACK        { $$ = create_array_node(NULL); }
+/* Strings and numbers are lexemes pointing into the scanner's buffer, which may move on
+   the next token: a key is interned and a value copied when the token is
+   reduced, which happens before the parser asks for a lookahead. */
+key: STRING { $$ = intern_key_len($1.text, $1.len); stream_key(ctx->stream, $$); } ;
+
+array: array_start values RBRACK { $$ = stream_end_array(ctx->stream, create_array_node(&ctx->ast, $2.head)); }
+     | array_start RBRACK        { $$ = stream_end_array(ctx->stream, create_array_node(&ctx->ast, 0)); }
      ;
 
-values: value              { $$ = $1; }
-      | value COMMA values { $$ = append_value($1, $3); }
+array_start: LBRACK { stream_begin_array(ctx->stream); } ;
+
+values: value               { $$ = append_node(&ctx->ast, (NodeList){ 0, 0 }, $1); }
+      | values COMMA value  { $$ = append_node(&ctx->ast, $1, $3); }
       ;
 
 %%
 
-void yyerror(const char *msg) {
-    fprintf(stderr, "Error: %s at line %d, column %d\n", msg, line, column);
-    exit(1);
-}
\ No newline at end of file
+static void filter_start(J2RContext *ctx);
+static void filter_end(J2RContext *ctx);
+
+int j2r_parse(J2RContext *ctx, int ndjson) {
+    ctx->start_token = ndjson ? NDJSON : 0;
+    filter_start(ctx);
+    int result = yyparse(ctx);
+    filter_end(ctx);
+    return result;
+}
+
+static int starts_value(int tok) {
+    return tok == LBRACE || tok == LBRACK || tok == NUMBER || tok == TRUE || tok == FALSE || tok == NULL_TOKEN;
+}
+
+// A string is a key when it comes first in an object or after one of its
+// commas. Every scalar value is reported as null: the schema writer only
+// needs to tell them from objects and arrays. So where a value goes, the
+// flex scanner skips a string without lexing it, unless a filter is
+// reading tokens ahead; the simd scanner has the string's end in its index.
+void j2r_scan_schema(J2RContext *ctx) {
+    char *in_object = NULL; // Per open object or array
+    int depth = 0;
+    int cap = 0;
+    int expect_key = 0;
+    int expect_value = 1;
+    int skip_strings = !ctx->simd && !ctx->projection;
+    // The nodes made here aren't the document's
+    uint64_t created[NODE_TYPES];
+    memcpy(created, ctx->ast.created, sizeof(created));
+    filter_start(ctx);
+
+    YYSTYPE lval;
+    int tok;
+    for (;;) {
+        if (skip_strings && expect_value && scanner_skip_string(ctx->scanner)) {
+            stream_value(ctx->stream, create_null_node(&ctx->ast));
+            expect_value = 0;
+            continue;
+        }
+        if ((tok = next_token(&lval, ctx)) == 0) break;
+        // The writer can't place a value without a key; the second pass
+        // stops at the same place with a syntax error
+        if (expect_key && starts_value(tok)) break;
+        expect_value = tok == COLON || tok == LBRACK || (tok == COMMA && depth > 0 && !in_object[depth - 1]);
+        switch (tok) {
+            case LBRACE:
+            case LBRACK:
+                if (depth == cap) {
+                    cap = cap ? cap * 2 : 64;
+                    in_object = realloc(in_object, cap);
+                }
+                in_object[depth++] = tok == LBRACE;
+                if (tok == LBRACE) stream_begin_object(ctx->stream);
+                else stream_begin_array(ctx->stream);
+                expect_key = tok == LBRACE;
+                break;
+            case RBRACE:
+            case RBRACK:
+                if (depth == 0) break;
+                if (in_object[--depth]) stream_end_object(ctx->stream, 0);
+                else stream_end_array(ctx->stream, 0);
+                expect_key = 0;
+                break;
+            case COMMA:
+                expect_key = depth > 0 && in_object[depth - 1];
+                break;
+            case STRING:
+                if (expect_key) {
+                    stream_key(ctx->stream, intern_key_len(lval.text.text, lval.text.len));
+                    expect_key = 0;
+                    break;
+                }
+                // fall through
+            case NUMBER:
+            case TRUE:
+            case FALSE:
+            case NULL_TOKEN:
+                stream_value(ctx->stream, create_null_node(&ctx->ast));
+                break;
+        }
+    }
+    free(in_object);
+    filter_end(ctx);
+    memcpy(ctx->ast.created, created, sizeof(created));
+}
+
+// In NDJSON mode the input is preceded by a made-up NDJSON token, which
+// picks the records rule instead of a single value
+static int raw_token(YYSTYPE *lval, J2RContext *ctx) {
+    if (ctx->start_token) {
+        int tok = ctx->start_token;
+        ctx->start_token = 0;
+        return tok;
+    }
+    if (ctx->simd) return structural_lex(lval, ctx->scanner);
+    return j2r_yylex(lval, ctx->scanner);
+}
+
+/* --select/--exclude: a filter between the scanner and the parser. A member
+   whose key isn't kept is never passed on, and the comma on one side of it
+   is dropped. Its value is read as one token, or, for an object or array,
+   skipped by the scanner up to its closing bracket without being lexed.
+   What follows a dropped member must still be a comma or a closing
+   bracket; anything else goes to the parser as an invalid token, so the
+   syntax error is where it would be without the filter. Where only some
+   paths below a key are kept, scalars are dropped too, so what is left is
+   the objects and arrays on the way to the selected keys. Tokens read
+   ahead to decide wait in a short queue. */
+typedef struct filter_frame {
+    PathState state;        // Of this object or array
+    PathState child;        // Of the value of its last kept member
+    char in_object;
+    char expect;            // The next token starts a member
+    char comma;             // Held back until the member after it is kept
+    char members;           // A member has been passed on
+    char ended;             // The last token passed on ended a value
+    char dropped;           // The last member was dropped
+} FilterFrame;
+
+struct token_filter {
+    FilterFrame *frames;    // One per open object or array
+    int depth;
+    int cap;
+    PathState root;
+    struct { int tok; YYSTYPE lval; } queue[4];
+    int queued;
+    int next;
+};
+
+static void filter_start(J2RContext *ctx) {
+    if (!ctx->projection) return;
+    ctx->filter = calloc(1, sizeof(struct token_filter));
+    ctx->filter->root = projection_root(ctx->projection);
+}
+
+static void filter_end(J2RContext *ctx) {
+    if (!ctx->filter) return;
+    free(ctx->filter->frames);
+    free(ctx->filter);
+    ctx->filter = NULL;
+}
+
+static int is_scalar(int tok) {
+    return tok == STRING || tok == NUMBER || tok == TRUE || tok == FALSE || tok == NULL_TOKEN;
+}
+
+// Follow the tokens the parser will see
+static void track(struct token_filter *f, int tok) {
+    if (tok == RBRACE || tok == RBRACK) {
+        if (f->depth > 0) f->depth--;
+        if (f->depth > 0) f->frames[f->depth - 1].ended = 1;
+        return;
+    }
+    if (tok != LBRACE && tok != LBRACK) {
+        if (f->depth > 0) f->frames[f->depth - 1].ended = is_scalar(tok);
+        return;
+    }
+    PathState state = f->root;
+    if (f->depth > 0) {
+        FilterFrame *parent = &f->frames[f->depth - 1];
+        state = parent->in_object ? parent->child : parent->state;
+    }
+    if (f->depth == f->cap) {
+        f->cap = f->cap ? f->cap * 2 : 64;
+        f->frames = realloc(f->frames, f->cap * sizeof(FilterFrame));
+    }
+    f->frames[f->depth++] = (FilterFrame){ state, state, tok == LBRACE, 1, 0, 0, 0, 0 };
+}
+
+static void enqueue(struct token_filter *f, int tok, const YYSTYPE *lval) {
+    f->queue[f->queued].tok = tok;
+    f->queue[f->queued].lval = *lval;
+    f->queued++;
+    track(f, tok);
+}
+
+static void skip_group(J2RContext *ctx) {
+    if (ctx->simd) structural_skip_group(ctx->scanner);
+    else scanner_skip_group(ctx->scanner);
+}
+
+// Decide on the member of frame starting with tok: queue its first tokens
+// and return 1, or drop it and return 0, or -1 if it has no value.
+// Anything else that isn't a member is passed on for the parser to report.
+static int keep_member(J2RContext *ctx, FilterFrame *frame, int tok, YYSTYPE *lval) {
+    struct token_filter *f = ctx->filter;
+    if (!frame->in_object) {
+        if (!frame->state.selected && is_scalar(tok)) return 0;
+        enqueue(f, tok, lval);
+        return 1;
+    }
+    if (tok != STRING) {
+        enqueue(f, tok, lval);
+        return 1;
+    }
+
+    PathState child;
+    YYSTYPE next;
+    int kept = projection_key(ctx->projection, &frame->state, lval->text.text, lval->text.len, &child);
+    if (!kept || !child.selected) {
+        // The key has to outlive the scanner's buffer, which may move
+        // while the tokens after it are read
+        if (kept) lval->text.text = intern_key_len(lval->text.text, lval->text.len);
+        else lval->text = (Lexeme){ "", 0 };
+        int colon = raw_token(&next, ctx);
+        if (colon != COLON) {
+            enqueue(f, tok, lval);
+            enqueue(f, colon, &next);
+            return 1;
+        }
+        int value = raw_token(&next, ctx);
+        if (!kept) {
+            if (value == LBRACE || value == LBRACK) skip_group(ctx);
+            else if (!is_scalar(value)) return -1;
+            return 0;
+        }
+        if (is_scalar(value)) return 0;
+        frame->child = child;
+        enqueue(f, tok, lval);
+        enqueue(f, colon, &next);
+        enqueue(f, value, &next);
+        return 1;
+    }
+    frame->child = child;
+    enqueue(f, tok, lval);
+    frame->ended = 0; // A key
+    return 1;
+}
+
+static int filter_token(YYSTYPE *lval, J2RContext *ctx) {
+    struct token_filter *f = ctx->filter;
+    for (;;) {
+        if (f->next < f->queued) {
+            *lval = f->queue[f->next].lval;
+            return f->queue[f->next++].tok;
+        }
+        f->next = f->queued = 0;
+
+        int tok = raw_token(lval, ctx);
+        FilterFrame *frame = f->depth ? &f->frames[f->depth - 1] : NULL;
+        if (frame && frame->dropped) {
+            frame->dropped = 0;
+            if (tok != COMMA && tok != RBRACE && tok != RBRACK && tok != 0) return J2R_YYUNDEF;
+        }
+        // Only a comma after a value can start a member; any other is
+        // passed on where it is, for the parser to report
+        if (!frame || (!frame->expect && (tok != COMMA || !frame->ended))) {
+            track(f, tok);
+            return tok;
+        }
+        if (!frame->expect) {
+            frame->ended = 0;
+            frame->comma = 1;
+            frame->expect = 1;
+            continue;
+        }
+        if (tok == COMMA || tok == RBRACE || tok == RBRACK || tok == 0) {
+            // Nothing to decide; a held comma goes first, so a trailing or
+            // doubled one is still a syntax error
+            int held = frame->comma;
+            frame->comma = 0;
+            frame->expect = tok == COMMA;
+            if (!held) {
+                track(f, tok);
+                return tok;
+            }
+            enqueue(f, tok, lval);
+            return COMMA;
+        }
+        frame->expect = 0;
+        int at = f->depth - 1;
+        int kept = keep_member(ctx, frame, tok, lval);
+        if (kept < 0) return J2R_YYUNDEF;
+        if (kept == 0) {
+            frame->ended = 1; // As if it had been passed on
+            frame->dropped = 1;
+            continue;
+        }
+        frame = &f->frames[at]; // Queuing a bracket may have moved it
+        int held = frame->comma && frame->members;
+        frame->comma = 0;
+        frame->members = 1;
+        if (held) return COMMA;
+    }
+}
+
+static int next_token(YYSTYPE *lval, J2RContext *ctx) {
+    if (ctx->filter) return filter_token(lval, ctx);
+    return raw_token(lval, ctx);
+}
+
+// yyparse() returns 1 after this; the caller reports the error and drops
+// the partial output
+static void yyerror(J2RContext *ctx, const char *msg) {
+    int line = ctx->simd ? structural_line(ctx->scanner) : scanner_line(ctx->scanner);
+    int column = ctx->simd ? structural_column(ctx->scanner) : scanner_column(ctx->scanner);
+    snprintf(ctx->error, sizeof(ctx->error), "%s at line %d, column %d", msg, line, column);
+}
@@ -0,0 +1,98 @@
+#include "projection.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct path {
+    char *text;         // The steps, split in place
+    char **steps;
+    int count;
+    int exclude;
+} Path;
+
+struct projection {
+    Path paths[PROJECTION_MAX];
+    int count;
+    int selects;
+};
+
+Projection *projection_new(void) {
+    return calloc(1, sizeof(Projection));
+}
+
+// Split one path into its keys, dropping $ and [*]
+static int add_path(Projection *p, const char *text, size_t len, int exclude) {
+    if (p->count == PROJECTION_MAX) return -1;
+    Path *path = &p->paths[p->count];
+    path->text = strndup(text, len);
+    path->steps = malloc((len / 2 + 1) * sizeof(char *));
+    path->count = 0;
+    path->exclude = exclude;
+    char *save;
+    for (char *step = strtok_r(path->text, ".", &save); step; step = strtok_r(NULL, ".", &save)) {
+        size_t n = strlen(step);
+        while (n >= 3 && strcmp(step + n - 3, "[*]") == 0) step[n -= 3] = '\0';
+        if (n == 0 || (path->count == 0 && strcmp(step, "$") == 0)) continue;
+        path->steps[path->count++] = step;
+    }
+    if (path->count == 0) {
+        free(path->text);
+        free(path->steps);
+        return -1;
+    }
+    p->count++;
+    if (!exclude) p->selects++;
+    return 0;
+}
+
+int projection_add(Projection *p, const char *paths, int exclude) {
+    for (;;) {
+        const char *comma = strchr(paths, ',');
+        size_t len = comma ? (size_t)(comma - paths) : strlen(paths);
+        if (add_path(p, paths, len, exclude) != 0) return -1;
+        if (!comma) return 0;
+        paths = comma + 1;
+    }
+}
+
+PathState projection_root(const Projection *p) {
+    PathState root = { 0, 0, p->selects == 0 };
+    if (p->count) root.alive = p->count == 64 ? ~0ULL : (1ULL << p->count) - 1;
+    return root;
+}
+
+static int step_matches(const char *step, const char *key, size_t len) {
+    if (step[0] == '*' && step[1] == '\0') return 1;
+    return strncmp(step, key, len) == 0 && step[len] == '\0';
+}
+
+int projection_key(const Projection *p, const PathState *state, const char *key, size_t len, PathState *child) {
+    int keep = state->selected;
+    child->alive = 0;
+    child->depth = state->depth + 1;
+    child->selected = state->selected;
+    for (uint64_t alive = state->alive; alive; alive &= alive - 1) {
+        int i = __builtin_ctzll(alive);
+        const Path *path = &p->paths[i];
+        if (!step_matches(path->steps[state->depth], key, len)) continue;
+        if (state->depth + 1 < path->count) {
+            // Some of what is below may be kept
+            child->alive |= 1ULL << i;
+            if (!path->exclude) keep = 1;
+        } else if (path->exclude) {
+            return 0;
+        } else {
+            child->selected = 1;
+            keep = 1;
+        }
+    }
+    return keep;
+}
+
+void projection_free(Projection *p) {
+    if (!p) return;
+    for (int i = 0; i < p->count; i++) {
+        free(p->paths[i].text);
+        free(p->paths[i].steps);
+    }
+    free(p);
+}
@@ -0,0 +1,38 @@
+#ifndef PROJECTION_H
+#define PROJECTION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// --select and --exclude: which parts of the input reach the parser. A path
+// is a dotted list of keys from the root, such as $.user.name: the leading
+// $ is optional, * matches any key, and [*] is accepted and ignored, since
+// arrays add no step (a path reaches into every element of the arrays it
+// passes through). With selected paths only those keys are kept, with
+// everything below them; excluded keys are dropped, and win over a select.
+// The values of dropped keys are skipped by the scanner without being lexed,
+// so their objects take no ids: the ids, and which tables and columns exist,
+// are not those of a full run.
+
+#define PROJECTION_MAX 64
+
+// Where a value sits relative to the paths
+typedef struct path_state {
+    uint64_t alive;     // Paths that match every key so far
+    int depth;          // Keys from the root
+    int selected;       // Everything below is kept, but for excludes
+} PathState;
+
+typedef struct projection Projection;
+
+Projection *projection_new(void);
+// Add a comma-separated list of paths. Returns -1 if one has no key or
+// there would be more than PROJECTION_MAX.
+int projection_add(Projection *p, const char *paths, int exclude);
+PathState projection_root(const Projection *p);
+// Whether the member called key (as written between its quotes) of an
+// object in state is kept; if it is, *child is the state of its value
+int projection_key(const Projection *p, const PathState *state, const char *key, size_t len, PathState *child);
+void projection_free(Projection *p);
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef SCANNER_H
+#define SCANNER_H
+
+#include <stddef.h>
+
+// A scanner over a file, for j2r_yylex(&yylval, scanner). With use_mmap the
+// file is mapped and scanned in place instead of being read through flex's
+// 16 KB refill buffer; files over 2 GB, too large for a flex buffer, are read
+// through it anyway. Returns NULL if the file can't be opened.
+void *scanner_open(const char *filename, int use_mmap);
+// Same over len bytes in memory, which flex copies since it writes into the
+// buffer it scans. Returns NULL if len is over 2 GB.
+void *scanner_open_buffer(const char *data, size_t len);
+void scanner_close(void *scanner);
+
+// --select/--exclude: skip the rest of an object or array whose opening
+// bracket was the last token, up to and including its closing bracket.
+// Only brackets, quotes and backslashes are looked at, so what is inside
+// isn't checked.
+void scanner_skip_group(void *scanner);
+
+// --two-pass: if the next token is a string, skip it without lexing it and
+// return 1; otherwise 0, with nothing read.
+int scanner_skip_string(void *scanner);
+// Position of the next character, for error messages
+int scanner_line(void *scanner);
+int scanner_column(void *scanner);
+
+#endif
@@ -1,353 +1,822 @@
 #include "schema.h"
+#include "intern.h"
+#include "csv.h"
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-static int id_counter = 1;
+// Table catalog: one table per name, so repeated nested keys share a table.
+// Tables are kept in creation order on a list and found through an open
+// addressing map on the interned name.
 
-typedef struct table_list {
-    Table *table;
-    struct table_list *next;
-} TableList;
+static unsigned name_hash(const char *name) {
+    return (unsigned)key_id(name) * 2654435761u;
+}
+
+// Slot holding the table called name, or the empty slot where it would go
+static Table **catalog_slot(Catalog *catalog, const char *name) {
+    unsigned mask = catalog->size - 1;
+    unsigned i = name_hash(name) & mask;
+    while (catalog->map[i] && catalog->map[i]->name != name) i = (i + 1) & mask;
+    return &catalog->map[i];
+}
+
+static void grow_catalog(Catalog *catalog) {
+    Table **old = catalog->map;
+    int old_size = catalog->size;
+    catalog->size = old_size ? old_size * 2 : 64;
+    catalog->map = calloc(catalog->size, sizeof(Table *));
+    for (int i = 0; i < old_size; i++) {
+        if (old[i]) *catalog_slot(catalog, old[i]->name) = old[i];
+    }
+    free(old);
+}
+
+// Table called name (interned), created on first use
+Table *catalog_table(Catalog *catalog, const char *name) {
+    if ((catalog->count + 1) * 4 > catalog->size * 3) grow_catalog(catalog);
+    Table **slot = catalog_slot(catalog, name);
+    if (*slot) return *slot;
+
+    Table *table = new_table(name);
+    *slot = table;
+    catalog->count++;
+    if (catalog->tail) catalog->tail->next = table;
+    else catalog->head = table;
+    catalog->tail = table;
+    return table;
+}
+
+Table *catalog_find(Catalog *catalog, const char *name) {
+    if (!catalog->size) return NULL;
+    return *catalog_slot(catalog, name);
+}
+
+// Forget the tables; they themselves go with free_tables(catalog->head)
+void catalog_clear(Catalog *catalog) {
+    free(catalog->map);
+    catalog->map = NULL;
+    catalog->size = 0;
+    catalog->count = 0;
+    catalog->head = NULL;
+    catalog->tail = NULL;
+    catalog->last_id = 0;
+}
+
+Table *new_table(const char *name) {
+    Table *table = malloc(sizeof(Table));
+    table->name = intern_key(name);
+    table->columns = NULL;
+    table->last_column = NULL;
+    table->column_count = 0;
+    table->column_map = NULL;
+    table->column_map_size = 0;
+    table->shape.keys = NULL;
+    table->shape.slots = NULL;
+    table->shape.count = 0;
+    table->shape.cap = 0;
+    table->column_at = NULL;
+    table->row_count = 0;
+    table->row_cap = 0;
+    table->strings.head = NULL;
+    table->text_bytes = 0;
+    table->spill = NULL;
+    table->csv_bytes = 0;
+    table->stream = NULL;
+    table->next = NULL;
+    return table;
+}
 
-static TableList *all_tables = NULL;
+static unsigned column_hash(const char *col_name) {
+    return (unsigned)key_id(col_name) * 2654435761u;
+}
 
-void add_table(Table *table) {
-    TableList *new_table = malloc(sizeof(TableList));
-    new_table->table = table;
-    new_table->next = all_tables;
-    all_tables = new_table;
+// Slot holding col_name, or the empty slot where it would go
+static ColumnSlot *column_slot(Table *table, const char *col_name) {
+    unsigned mask = table->column_map_size - 1;
+    unsigned i = column_hash(col_name) & mask;
+    while (table->column_map[i].name && table->column_map[i].name != col_name) i = (i + 1) & mask;
+    return &table->column_map[i];
 }
 
-void free_all_tables() {
-    TableList *tl = all_tables;
-    while (tl) {
-        TableList *next = tl->next;
-        free(tl);
-        tl = next;
+static void grow_column_map(Table *table) {
+    ColumnSlot *old = table->column_map;
+    int old_size = table->column_map_size;
+    table->column_map_size = old_size ? old_size * 2 : 16;
+    table->column_map = calloc(table->column_map_size, sizeof(ColumnSlot));
+    for (int i = 0; i < old_size; i++) {
+        if (old[i].name) *column_slot(table, old[i].name) = old[i];
     }
-    all_tables = NULL;
+    free(old);
+    // The map always has room for more columns than there are
+    table->column_at = realloc(table->column_at, table->column_map_size * sizeof(Column *));
 }
 
 // Helper: Add column if not exists
 void add_column_if_missing(Table *table, const char *col_name) {
-    for (Column *c = table->columns; c; c = c->next) {
-        if (strcmp(c->name, col_name) == 0) return;
-    }
+    if ((table->column_count + 1) * 4 > table->column_map_size * 3) grow_column_map(table);
+    ColumnSlot *slot = column_slot(table, col_name);
+    if (slot->name) return;
+    slot->name = col_name;
+    slot->index = table->column_count++;
+
     Column *col = malloc(sizeof(Column));
-    col->name = strdup(col_name);
+    col->name = col_name;
+    col->type = COLUMN_ANY;
     col->next = NULL;
+    // Rows already in the table have no cell here: type 0 is CELL_EMPTY
+    col->types = calloc(table->row_cap, 1);
+    col->values = malloc(table->row_cap * sizeof(CellValue));
+    table->column_at[slot->index] = col;
     // Append to end
-    if (!table->columns) {
-        table->columns = col;
-    } else {
-        Column *last = table->columns;
-        while (last->next) last = last->next;
-        last->next = col;
-    }
+    if (!table->columns) table->columns = col;
+    else table->last_column->next = col;
+    table->last_column = col;
 }
 
 // Helper: Collect all keys from all objects in array
-void collect_columns_from_array(Table *table, AstNode *array) {
-    for (AstNode *v = array->data.array.value; v; v = v->data.array.next) {
-        if (v->type != NODE_OBJECT) continue;
-        for (AstNode *p = v->data.pair.value; p; p = p->data.pair.next) {
-            if (p->type == NODE_PAIR && p->data.pair.key && p->data.pair.value &&
-                p->data.pair.value->type != NODE_ARRAY && p->data.pair.value->type != NODE_OBJECT) {
-                add_column_if_missing(table, p->data.pair.key);
+void collect_columns_from_array(Table *table, const Ast *ast, const AstNode *array) {
+    const AstNode *nodes = ast->nodes;
+    for (NodeId v = array->data.first; v; v = nodes[v].next) {
+        if (node_type(&nodes[v]) != NODE_OBJECT) continue;
+        ShapeCursor cursor = { 0, 0 };
+        for (NodeId m = nodes[v].data.first; m; m = nodes[m].next) {
+            const char *key = node_key(&nodes[m]);
+            int idx = shape_column(table, &cursor, key);
+            // Nested objects get a column for their id, as in add_object_columns
+            if (idx < 0 && node_type(&nodes[m]) != NODE_ARRAY) {
+                add_column_if_missing(table, key);
+                shape_set_column(table, &cursor, key, column_index(table, key));
             }
         }
     }
 }
 
-// Create table for array of objects, collecting all possible columns
-Table *create_table_for_array(const char *name, AstNode *array) {
-    Table *table = malloc(sizeof(Table));
-    table->name = strdup(name);
-    table->columns = NULL;
-    table->rows = NULL;
-    table->next = NULL;
-
-    // id column always first
-    add_column_if_missing(table, "id");
+// Columns of an array of objects: id first, then every scalar key
+static void add_array_columns(Table *table, const Ast *ast, const AstNode *array) {
+    add_column_if_missing(table, intern_key("id"));
+    collect_columns_from_array(table, ast, array);
+}
 
-    collect_columns_from_array(table, array);
+// Columns of a single object
+static void add_object_columns(Table *table, const Ast *ast, const AstNode *object) {
+    const AstNode *nodes = ast->nodes;
+    add_column_if_missing(table, intern_key("id"));
+    // Scalars, and nested objects for their id; arrays get tables of their own
+    for (NodeId m = object->data.first; m; m = nodes[m].next) {
+        if (node_type(&nodes[m]) != NODE_ARRAY) add_column_if_missing(table, node_key(&nodes[m]));
+    }
+}
 
-    return table;
+// Find column index by name
+int column_index(Table *table, const char *col_name) {
+    if (!table->column_map) return -1;
+    ColumnSlot *slot = column_slot(table, col_name);
+    return slot->name ? slot->index : -1;
 }
 
-// Create table for a single object
-Table *create_table_for_object(const char *name, AstNode *object) {
-    Table *table = malloc(sizeof(Table));
-    table->name = strdup(name);
-    table->columns = NULL;
-    table->rows = NULL;
-    table->next = NULL;
+// Shape cache: objects in a table almost always repeat the previous object's
+// key order, so each key is first checked against the same position of the
+// cached shape, which costs a pointer compare. From the first key that
+// differs the cursor falls back to the column map and records the new shape.
+int shape_column(Table *table, ShapeCursor *cursor, const char *key) {
+    Shape *shape = &table->shape;
+    int pos = cursor->pos++;
+    if (!cursor->diverged && pos < shape->count && shape->keys[pos] == key) {
+        return shape->slots[pos];
+    }
 
-    add_column_if_missing(table, "id");
-    for (AstNode *p = object->data.pair.value; p; p = p->data.pair.next) {
-        if (p->type == NODE_PAIR && p->data.pair.key && p->data.pair.value &&
-            p->data.pair.value->type != NODE_ARRAY && p->data.pair.value->type != NODE_OBJECT) {
-            add_column_if_missing(table, p->data.pair.key);
-        }
-        // For nested objects, add a column to store their id
-        if (p->type == NODE_PAIR && p->data.pair.key && p->data.pair.value &&
-            p->data.pair.value->type == NODE_OBJECT) {
-            add_column_if_missing(table, p->data.pair.key);
+    int idx = column_index(table, key);
+    if (!cursor->diverged) {
+        cursor->diverged = 1;
+        if (pos < shape->count) shape->count = pos;
+    }
+    if (pos == shape->count) {
+        if (shape->count == shape->cap) {
+            shape->cap = shape->cap ? shape->cap * 2 : 16;
+            shape->keys = realloc(shape->keys, shape->cap * sizeof(const char *));
+            shape->slots = realloc(shape->slots, shape->cap * sizeof(int));
         }
+        shape->keys[pos] = key;
+        shape->slots[pos] = idx;
+        shape->count++;
     }
-    return table;
+    return idx;
 }
 
-// Find column index by name
-int column_index(Table *table, const char *col_name) {
-    int idx = 0;
-    for (Column *c = table->columns; c; c = c->next, idx++) {
-        if (strcmp(c->name, col_name) == 0) return idx;
-    }
-    return -1;
-}
-
-// Fill row values for object
-void fill_row_values(Table *table, Row *row, AstNode *object) {
-    int col_count = 0;
-    for (Column *c = table->columns; c; c = c->next) col_count++;
-    row->values = calloc(col_count, sizeof(char *));
-    row->value_count = col_count;
-
-    // id
-    int idx = column_index(table, "id");
-    if (idx >= 0) {
-        row->values[idx] = malloc(32);
-        snprintf(row->values[idx], 32, "%d", row->id);
-    }
-    // other columns
-    for (AstNode *p = object->data.pair.value; p; p = p->data.pair.next) {
-        if (p->type != NODE_PAIR || !p->data.pair.key || !p->data.pair.value) continue;
-        if (p->data.pair.value->type == NODE_ARRAY || p->data.pair.value->type == NODE_OBJECT) continue;
-        idx = column_index(table, p->data.pair.key);
-        if (idx >= 0) {
-            if (p->data.pair.value->type == NODE_STRING) {
-                row->values[idx] = strdup(p->data.pair.value->data.string);
-            } else if (p->data.pair.value->type == NODE_NUMBER) {
-                row->values[idx] = malloc(32);
-                snprintf(row->values[idx], 32, "%.0f", p->data.pair.value->data.number);
-            } else if (p->data.pair.value->type == NODE_BOOL) {
-                row->values[idx] = strdup(p->data.pair.value->data.boolean ? "true" : "false");
-            } else if (p->data.pair.value->type == NODE_NULL) {
-                row->values[idx] = strdup("");
+// The key just looked up got a column after all
+void shape_set_column(Table *table, ShapeCursor *cursor, const char *key, int idx) {
+    int pos = cursor->pos - 1;
+    if (pos >= 0 && pos < table->shape.count && table->shape.keys[pos] == key) {
+        table->shape.slots[pos] = idx;
+    }
+}
+
+// Format a scalar as it appears in a CSV cell (NULL for objects and arrays)
+char *format_scalar(const AstNode *value) {
+    switch (node_type(value)) {
+        case NODE_STRING:
+            return strdup(value->data.string);
+        case NODE_NUMBER:
+            return strdup(value->data.digits); // As written in the input
+        case NODE_BOOL:
+            return strdup(value->data.boolean ? "true" : "false");
+        case NODE_NULL:
+            return strdup("");
+        default:
+            return NULL;
+    }
+}
+
+char *format_id(int id) {
+    char buf[21];
+    int len = format_int(buf, id);
+    return memcpy(malloc(len + 1), buf, len + 1);
+}
+
+int next_row_id(Catalog *catalog) {
+    return ++catalog->last_id;
+}
+
+// Numbers that print back exactly as written from an int64 are stored as
+// one: no leading zeros, no "-0", at most 18 digits
+static int integral_digits(const char *digits, int64_t *value) {
+    const char *p = digits + (*digits == '-');
+    int64_t v = 0;
+    int n = 0;
+    for (; p[n] >= '0' && p[n] <= '9' && n < 18; n++) v = v * 10 + (p[n] - '0');
+    if (p[n] != '\0' || n == 0 || (p[0] == '0' && (n > 1 || p != digits))) return 0;
+    *value = *digits == '-' ? -v : v;
+    return 1;
+}
+
+Cell text_cell(Table *table, const char *text) {
+    Cell cell;
+    size_t len = strlen(text);
+    if (len <= CELL_SHORT_MAX) {
+        cell.type = CELL_SHORT + len;
+        memcpy(cell.value.bytes, text, len);
+        return cell;
+    }
+    cell.type = CELL_TEXT;
+    cell.value.text = arena_strndup(&table->strings, text, len);
+    table->text_bytes += len + 1;
+    return cell;
+}
+
+// The cell of a scalar with its text still in the AST
+static Cell scalar_view(const AstNode *value) {
+    Cell cell = { CELL_EMPTY };
+    switch (node_type(value)) {
+        case NODE_STRING:
+            cell.type = CELL_TEXT;
+            cell.value.text = value->data.string;
+            return cell;
+        case NODE_NUMBER:
+            // Short ones are kept as text too, which saves formatting them
+            if (strlen(value->data.digits) > CELL_SHORT_MAX && integral_digits(value->data.digits, &cell.value.i)) {
+                cell.type = CELL_INT;
+            } else {
+                cell.type = CELL_TEXT;
+                cell.value.text = value->data.digits;
             }
-        }
+            return cell;
+        case NODE_BOOL:
+            cell.type = value->data.boolean ? CELL_TRUE : CELL_FALSE;
+            return cell;
+        default:
+            return cell;
+    }
+}
+
+Cell scalar_cell(Table *table, const AstNode *value) {
+    Cell cell = scalar_view(value);
+    if (cell.type == CELL_TEXT) cell = text_cell(table, cell.value.text);
+    return cell;
+}
+
+static Cell int_cell(int64_t value) {
+    Cell cell = { CELL_INT };
+    cell.value.i = value;
+    return cell;
+}
+
+static void grow_rows(Table *table) {
+    table->row_cap = table->row_cap ? table->row_cap * 2 : 64;
+    for (Column *c = table->columns; c; c = c->next) {
+        c->types = realloc(c->types, table->row_cap);
+        c->values = realloc(c->values, table->row_cap * sizeof(CellValue));
+    }
+}
+
+long add_row(Table *table, const Cell *cells, int count) {
+    if (table->row_count == table->row_cap) grow_rows(table);
+    long row = table->row_count++;
+    int col_count = table->column_count;
+    if (count > col_count) count = col_count;
+    for (int i = 0; i < count; i++) {
+        Column *c = table->column_at[i];
+        c->types[row] = cells[i].type;
+        c->values[row] = cells[i].value;
+    }
+    for (int i = count; i < col_count; i++) table->column_at[i]->types[row] = CELL_EMPTY;
+    return row;
+}
+
+const char *table_cell(const Table *table, const Column *column, long row, char *buf) {
+    (void)table;
+    int type = column->types[row];
+    switch (type) {
+        case CELL_EMPTY:
+            return NULL;
+        case CELL_INT:
+            format_int(buf, column->values[row].i);
+            return buf;
+        case CELL_TEXT:
+            return column->values[row].text;
+        case CELL_TRUE:
+            return "true";
+        case CELL_FALSE:
+            return "false";
+        default:
+            memcpy(buf, column->values[row].bytes, type - CELL_SHORT);
+            buf[type - CELL_SHORT] = '\0';
+            return buf;
+    }
+}
+
+// dir/<name><suffix>, to be freed
+static char *table_path(const char *dir, const Table *table, const char *suffix) {
+    size_t len = strlen(dir) + strlen(table->name) + strlen(suffix) + 2;
+    char *path = malloc(len);
+    snprintf(path, len, "%s/%s%s", dir, table->name, suffix);
+    return path;
+}
+
+static CsvWriter *open_csv(const char *path, CsvWriter *(*open_file)(const char *)) {
+    CsvWriter *out = open_file(path);
+    if (!out) {
+        fprintf(stderr, "Error opening %s\n", path);
+        exit(1);
     }
+    return out;
+}
+
+static void write_header(CsvWriter *out, const Table *table) {
+    for (Column *c = table->columns; c; c = c->next) csv_field(out, c->name);
+    csv_end_row(out);
 }
 
-// Recursively create tables for AST
-Table *create_tables_recursive(AstNode *node, const char *name, const char *parent_name, int parent_id) {
-    if (!node) return NULL;
-    Table *main_table = NULL, *last_table = NULL;
-
-    if (node->type == NODE_OBJECT) {
-        main_table = create_table_for_object(name, node);
-        add_table(main_table);
-
-        Row *row = malloc(sizeof(Row));
-        row->id = id_counter++;
-        fill_row_values(main_table, row, node);
-
-        // For each pair, if value is an object, create child table and store its id in parent row
-        for (AstNode *p = node->data.pair.value; p; p = p->data.pair.next) {
-            if (p->type != NODE_PAIR || !p->data.pair.key || !p->data.pair.value) continue;
-            if (p->data.pair.value->type == NODE_OBJECT) {
-                Table *child = create_tables_recursive(p->data.pair.value, p->data.pair.key, name, row->id);
-                if (child && child->rows) {
-                    // Store the id of the nested object in the parent row
-                    int idx = column_index(main_table, p->data.pair.key);
-                    if (idx >= 0) {
-                        char id_buf[32];
-                        snprintf(id_buf, sizeof(id_buf), "%d", child->rows->id);
-                        if (row->values[idx]) free(row->values[idx]);
-                        row->values[idx] = strdup(id_buf);
-                    }
-                }
-                // Chain child tables
-                if (child) {
-                    if (!last_table) main_table->next = child;
-                    else last_table->next = child;
-                    while (child->next) child = child->next;
-                    last_table = child;
-                }
-            } else if (p->data.pair.value->type == NODE_ARRAY) {
-                Table *child = create_tables_recursive(p->data.pair.value, p->data.pair.key, name, row->id);
-                if (child) {
-                    if (!last_table) main_table->next = child;
-                    else last_table->next = child;
-                    while (child->next) child = child->next;
-                    last_table = child;
-                }
+// The rows in memory; integers are formatted here rather than kept as text.
+// Each row is put together in line and handed to the writer whole, which
+// costs a call per row instead of two per cell.
+static void write_rows(CsvWriter *out, const Table *table) {
+    Column **columns = table->column_at;
+    int col_count = table->column_count;
+    size_t cap = 256;
+    char *line = malloc(cap);
+    for (long r = 0; r < table->row_count; r++) {
+        // Fetch the cache lines of the rows ahead, column by column
+        if (r % 8 == 0) {
+            for (int i = 0; i < col_count; i++) {
+                __builtin_prefetch(&columns[i]->values[r + 16]);
+                if (r % 64 == 0) __builtin_prefetch(&columns[i]->types[r + 64]);
             }
         }
-
-        row->next = main_table->rows;
-        main_table->rows = row;
-        return main_table;
-    } else if (node->type == NODE_ARRAY) {
-        AstNode *first = node->data.array.value;
-        if (!first) return NULL;
-        int is_obj_array = (first->type == NODE_OBJECT);
-
-        if (is_obj_array) {
-            Table *table = create_table_for_array(name, node);
-            add_table(table);
-            for (AstNode *v = node->data.array.value; v; v = v->data.array.next) {
-                Row *row = malloc(sizeof(Row));
-                row->id = id_counter++;
-                fill_row_values(table, row, v);
-                row->next = table->rows;
-                table->rows = row;
-
-                // Recursively handle nested arrays/objects
-                for (AstNode *p = v->data.pair.value; p; p = p->data.pair.next) {
-                    if (p->type != NODE_PAIR || !p->data.pair.key || !p->data.pair.value) continue;
-                    if (p->data.pair.value->type == NODE_ARRAY || p->data.pair.value->type == NODE_OBJECT) {
-                        Table *child = create_tables_recursive(p->data.pair.value, p->data.pair.key, name, row->id);
-                        if (child && p->data.pair.value->type == NODE_OBJECT && child->rows) {
-                            // Store the id of the nested object in the parent row
-                            int idx = column_index(table, p->data.pair.key);
-                            if (idx >= 0) {
-                                char id_buf[32];
-                                snprintf(id_buf, sizeof(id_buf), "%d", child->rows->id);
-                                if (row->values[idx]) free(row->values[idx]);
-                                row->values[idx] = strdup(id_buf);
-                            }
-                        }
-                        if (child) {
-                            if (!last_table) table->next = child;
-                            else last_table->next = child;
-                            while (child->next) child = child->next;
-                            last_table = child;
-                        }
-                    }
-                }
+        size_t len = 0;
+        for (int i = 0; i < col_count; i++) {
+            const Column *c = columns[i];
+            int type = c->types[r];
+            const char *text = NULL;
+            size_t n = 0;
+            switch (type) {
+                case CELL_EMPTY:
+                    break;
+                case CELL_INT:
+                    n = 20;
+                    break;
+                case CELL_TEXT:
+                    text = c->values[r].text;
+                    n = strlen(text);
+                    break;
+                case CELL_TRUE:
+                    text = "true";
+                    n = 4;
+                    break;
+                case CELL_FALSE:
+                    text = "false";
+                    n = 5;
+                    break;
+                default:
+                    text = c->values[r].bytes;
+                    n = type - CELL_SHORT;
+                    break;
             }
-            return table;
-        } else {
-            // Array of primitives: <parent>_id, index, value
-            Table *table = malloc(sizeof(Table));
-            table->name = strdup(name);
-            table->columns = NULL;
-            table->rows = NULL;
-            table->next = NULL;
-
-            // Add parent id column (e.g., movie_id), index, value
-            char fk_col[128];
-            if (parent_name && strlen(parent_name) > 0) {
-                snprintf(fk_col, sizeof(fk_col), "%s_id", parent_name);
-            } else {
-                snprintf(fk_col, sizeof(fk_col), "parent_id");
+            if (len + n + 1 > cap) {
+                while (len + n + 1 > cap) cap *= 2;
+                line = realloc(line, cap);
             }
-            add_column_if_missing(table, fk_col);
-            add_column_if_missing(table, "index");
-            add_column_if_missing(table, "value");
-
-            add_table(table);
-
-            int idx = 0;
-            for (AstNode *v = node->data.array.value; v; v = v->data.array.next, idx++) {
-                Row *row = malloc(sizeof(Row));
-                row->id = 0; // not used
-                int col_count = 0;
-                for (Column *c = table->columns; c; c = c->next) col_count++;
-                row->values = calloc(col_count, sizeof(char *));
-                row->value_count = col_count;
-
-                int fk_idx = column_index(table, fk_col);
-                int index_idx = column_index(table, "index");
-                int value_idx = column_index(table, "value");
-
-                if (fk_idx >= 0) {
-                    row->values[fk_idx] = malloc(32);
-                    snprintf(row->values[fk_idx], 32, "%d", parent_id);
-                }
-                if (index_idx >= 0) {
-                    row->values[index_idx] = malloc(32);
-                    snprintf(row->values[index_idx], 32, "%d", idx);
-                }
-                if (value_idx >= 0) {
-                    if (v->type == NODE_STRING) row->values[value_idx] = strdup(v->data.string);
-                    else if (v->type == NODE_NUMBER) {
-                        row->values[value_idx] = malloc(32);
-                        snprintf(row->values[value_idx], 32, "%.0f", v->data.number);
-                    } else if (v->type == NODE_BOOL) {
-                        row->values[value_idx] = strdup(v->data.boolean ? "true" : "false");
-                    }
-                }
-                row->next = table->rows;
-                table->rows = row;
+            if (i > 0) line[len++] = ',';
+            if (type == CELL_INT) {
+                len += format_int(line + len, c->values[r].i);
+            } else if (n > 0) {
+                memcpy(line + len, text, n);
+                len += n;
             }
-            return table;
         }
+        csv_raw(out, line, len);
+        csv_end_row(out);
     }
-    return NULL;
+    free(line);
 }
 
-Table *create_tables(AstNode *node) {
-    return create_tables_recursive(node, "table_name", NULL, 0);
+// --max-memory: a table's file is started with the header it has at its
+// first spill and rows are appended to it as they pile up. Rows spilled
+// while the table had n columns are one span; if columns are added later,
+// the file is rewritten at the end with the spans padded to the final
+// header, as stream mode does with its spools.
+typedef struct spill_span {
+    int col_count;
+    long rows;
+    struct spill_span *next;
+} SpillSpan;
+
+typedef struct spill {
+    int header_columns;     // Columns in the header at the top of the file
+    long rows;
+    size_t bytes;           // Size of the file so far
+    SpillSpan *spans;
+    SpillSpan *last_span;
+} Spill;
+
+// Smallest share of the budget a table gets before it spills
+#define SPILL_MIN (64 * 1024)
+
+long table_rows(const Table *table) {
+    return table->row_count + (table->spill ? table->spill->rows : 0);
 }
 
-void write_csv(Table *table, const char *dir) {
-    for (; table; table = table->next) {
-        char path[256];
-        snprintf(path, sizeof(path), "%s/%s.csv", dir, table->name);
-        FILE *fp = fopen(path, "w");
-        if (!fp) {
-            fprintf(stderr, "Error opening %s\n", path);
-            exit(1);
+// Append the rows in memory to the table's file and drop them
+static void spill_table(Table *table, const char *dir) {
+    char *path = table_path(dir, table, ".csv");
+    Spill *spill = table->spill;
+    CsvWriter *out;
+    if (!spill) {
+        spill = calloc(1, sizeof(Spill));
+        table->spill = spill;
+        out = open_csv(path, csv_open);
+        write_header(out, table);
+        spill->header_columns = table->column_count;
+    } else {
+        out = open_csv(path, csv_append);
+    }
+    write_rows(out, table);
+    spill->bytes += csv_close(out);
+    free(path);
+
+    int col_count = table->column_count;
+    if (!spill->last_span || spill->last_span->col_count != col_count) {
+        SpillSpan *span = malloc(sizeof(SpillSpan));
+        span->col_count = col_count;
+        span->rows = 0;
+        span->next = NULL;
+        if (spill->last_span) spill->last_span->next = span;
+        else spill->spans = span;
+        spill->last_span = span;
+    }
+    spill->last_span->rows += table->row_count;
+    spill->rows += table->row_count;
+    table->row_count = 0;
+    arena_reset(&table->strings);
+    table->text_bytes = 0;
+}
+
+// Spill the table if its rows are over its share of the budget. Cells are
+// counted at their 9 bytes each plus their text.
+static void check_memory(Catalog *catalog, Table *table) {
+    if (!catalog->max_memory) return;
+    size_t used = (size_t)table->row_count * table->column_count * (sizeof(CellValue) + 1) + table->text_bytes;
+    size_t share = catalog->max_memory / catalog->count;
+    // Each spill opens the file, so tiny budgets still spill in batches
+    if (share < SPILL_MIN) share = SPILL_MIN;
+    if (used > share) spill_table(table, catalog->spill_dir);
+}
+
+// Write a spilled table's last rows: appended if the header still holds,
+// otherwise the whole file is rewritten under the final header
+static void finish_spill(Table *table, const char *dir) {
+    Spill *spill = table->spill;
+    char *path = table_path(dir, table, ".csv");
+    if (spill->header_columns == table->column_count) {
+        CsvWriter *out = open_csv(path, csv_append);
+        write_rows(out, table);
+        table->csv_bytes = spill->bytes + csv_close(out);
+        free(path);
+        return;
+    }
+
+    char *old_path = table_path(dir, table, ".csv.part");
+    if (rename(path, old_path) != 0) {
+        fprintf(stderr, "Error renaming %s\n", path);
+        exit(1);
+    }
+    FILE *old = fopen(old_path, "r");
+    if (!old) {
+        fprintf(stderr, "Error opening %s\n", old_path);
+        exit(1);
+    }
+    int c;
+    while ((c = fgetc(old)) != EOF && c != '\n') {} // The old header
+    CsvWriter *out = open_csv(path, csv_open);
+    write_header(out, table);
+    for (SpillSpan *span = spill->spans; span; span = span->next) {
+        csv_copy_rows(out, old, span->rows, table->column_count - span->col_count);
+    }
+    write_rows(out, table);
+    table->csv_bytes = csv_close(out);
+    fclose(old);
+    remove(old_path);
+    free(old_path);
+    free(path);
+}
+
+// An object whose row is being filled, or an array of objects whose elements
+// are being visited. The row only goes into the table once everything below
+// the object is done; until then its cells are kept in the frame, whose
+// buffer is reused by the next object at the same depth. Their text stays in
+// the AST until then, so a spill can always drop the table's text, even
+// while rows of the same table are open above it.
+typedef struct build_frame {
+    Table *table;
+    int is_row;             // 0 for an array
+    int id;
+    Cell *cells;            // One per column the table had when the row began
+    int cell_count;
+    int cell_cap;
+    NodeId next;            // next member of the object, or element of the array
+} BuildFrame;
+
+typedef struct build_stack {
+    BuildFrame *frames;
+    int depth;
+    int cap;
+} BuildStack;
+
+static BuildFrame *push_frame(BuildStack *stack, Table *table, int is_row, NodeId next) {
+    if (stack->depth == stack->cap) {
+        int cap = stack->cap ? stack->cap * 2 : 64;
+        stack->frames = realloc(stack->frames, cap * sizeof(BuildFrame));
+        memset(stack->frames + stack->cap, 0, (cap - stack->cap) * sizeof(BuildFrame));
+        stack->cap = cap;
+    }
+    BuildFrame *f = &stack->frames[stack->depth++];
+    f->table = table;
+    f->is_row = is_row;
+    f->next = next;
+    f->cell_count = 0;
+    return f;
+}
+
+// Start the row of an object of table: its id and scalars now, its nested
+// objects and arrays as the frame is worked off
+static int begin_object_row(Catalog *catalog, BuildStack *stack, Table *table, const Ast *ast,
+                            const AstNode *object) {
+    const AstNode *nodes = ast->nodes;
+    BuildFrame *f = push_frame(stack, table, 1, object->data.first);
+    int col_count = table->column_count;
+    if (col_count > f->cell_cap) {
+        f->cell_cap = col_count;
+        f->cells = realloc(f->cells, col_count * sizeof(Cell));
+    }
+    memset(f->cells, 0, col_count * sizeof(Cell)); // CELL_EMPTY
+    f->cell_count = col_count;
+    f->id = next_row_id(catalog);
+
+    int idx = column_index(table, intern_key("id"));
+    if (idx >= 0) f->cells[idx] = int_cell(f->id);
+    ShapeCursor cursor = { 0, 0 };
+    for (NodeId m = object->data.first; m; m = nodes[m].next) {
+        const AstNode *value = &nodes[m];
+        idx = shape_column(table, &cursor, node_key(value));
+        if (node_type(value) == NODE_ARRAY || node_type(value) == NODE_OBJECT) continue;
+        // A key may repeat, or be "id": the last one wins
+        if (idx >= 0 && idx < col_count) f->cells[idx] = scalar_view(value);
+    }
+    return f->id;
+}
+
+// Array of primitives: <parent>_id, index, value
+static void add_value_rows(Catalog *catalog, Table *table, const Ast *ast, const AstNode *array,
+                           const char *parent_name, int parent_id) {
+    // Add parent id column (e.g., movie_id), index, value
+    char fk_col[128];
+    if (parent_name && strlen(parent_name) > 0) {
+        snprintf(fk_col, sizeof(fk_col), "%s_id", parent_name);
+    } else {
+        snprintf(fk_col, sizeof(fk_col), "parent_id");
+    }
+    add_column_if_missing(table, intern_key(fk_col));
+    add_column_if_missing(table, intern_key("index"));
+    add_column_if_missing(table, intern_key("value"));
+
+    int fk_idx = column_index(table, intern_key(fk_col));
+    int index_idx = column_index(table, intern_key("index"));
+    int value_idx = column_index(table, intern_key("value"));
+
+    // Only these three columns are ever set, so rows are written straight
+    // into them and every other column is left empty
+    int idx = 0;
+    for (NodeId v = array->data.first; v; v = ast->nodes[v].next, idx++) {
+        long row = add_row(table, NULL, 0);
+        table->column_at[fk_idx]->types[row] = CELL_INT;
+        table->column_at[fk_idx]->values[row].i = parent_id;
+        table->column_at[index_idx]->types[row] = CELL_INT;
+        table->column_at[index_idx]->values[row].i = idx;
+        Cell value = scalar_cell(table, &ast->nodes[v]);
+        table->column_at[value_idx]->types[row] = value.type;
+        table->column_at[value_idx]->values[row] = value.value;
+        check_memory(catalog, table);
+    }
+}
+
+// A value called name below a row of parent_name; returns the id of an object
+static int add_value(Catalog *catalog, BuildStack *stack, const Ast *ast, const AstNode *node,
+                     const char *name, const char *parent_name, int parent_id) {
+    if (node_type(node) == NODE_OBJECT) {
+        Table *table = catalog_table(catalog, name);
+        add_object_columns(table, ast, node);
+        return begin_object_row(catalog, stack, table, ast, node);
+    }
+    if (node_type(node) == NODE_ARRAY && node->data.first) {
+        Table *table = catalog_table(catalog, name);
+        if (node_type(&ast->nodes[node->data.first]) == NODE_OBJECT) {
+            add_array_columns(table, ast, node);
+            push_frame(stack, table, 0, node->data.first);
+        } else {
+            add_value_rows(catalog, table, ast, node, parent_name, parent_id);
         }
+    }
+    return 0;
+}
 
-        int col_count = 0;
-        for (Column *c = table->columns; c; c = c->next) {
-            if (col_count > 0) fprintf(fp, ",");
-            fprintf(fp, "%s", c->name);
-            col_count++;
+// Fill the catalog from the document, depth first on an explicit stack so
+// nesting depth and list length only cost heap. Ids are handed out when an
+// object is reached and its row is appended once everything below it is
+// done, the same order the stream writer produces.
+Table *create_tables(Catalog *catalog, const Ast *ast, NodeId root) {
+    const AstNode *nodes = ast->nodes;
+    BuildStack stack = { NULL, 0, 0 };
+    if (root) add_value(catalog, &stack, ast, &nodes[root], intern_key("table_name"), NULL, 0);
+
+    while (stack.depth > 0) {
+        BuildFrame *f = &stack.frames[stack.depth - 1];
+        NodeId next = f->next;
+
+        if (!f->is_row) {
+            // Array of objects: the elements that are objects get rows
+            if (!next) {
+                stack.depth--;
+                continue;
+            }
+            f->next = nodes[next].next;
+            if (node_type(&nodes[next]) == NODE_OBJECT) begin_object_row(catalog, &stack, f->table, ast, &nodes[next]);
+            continue;
         }
-        fprintf(fp, "\n");
 
-        for (Row *r = table->rows; r; r = r->next) {
-            for (int i = 0; i < col_count; i++) {
-                if (i > 0) fprintf(fp, ",");
-                fprintf(fp, "%s", r->values[i] ? r->values[i] : "");
+        // Object: visit its nested objects and arrays, then add the row
+        while (next && node_type(&nodes[next]) != NODE_ARRAY && node_type(&nodes[next]) != NODE_OBJECT) {
+            next = nodes[next].next;
+        }
+        if (!next) {
+            for (int i = 0; i < f->cell_count; i++) {
+                if (f->cells[i].type == CELL_TEXT) f->cells[i] = text_cell(f->table, f->cells[i].value.text);
             }
-            fprintf(fp, "\n");
+            add_row(f->table, f->cells, f->cell_count);
+            check_memory(catalog, f->table);
+            stack.depth--;
+            continue;
         }
-        fclose(fp);
+        f->next = nodes[next].next;
+        Table *table = f->table;
+        int depth = stack.depth; // f moves if the stack grows
+        const AstNode *value = &nodes[next];
+        const char *key = node_key(value);
+        int child_id = add_value(catalog, &stack, ast, value, key, table->name, f->id);
+        if (node_type(value) == NODE_OBJECT) {
+            // Store the id of the nested object in the parent row
+            f = &stack.frames[depth - 1];
+            int idx = column_index(table, key);
+            if (idx >= 0 && idx < f->cell_count) f->cells[idx] = int_cell(child_id);
+        }
+    }
+    for (int i = 0; i < stack.cap; i++) free(stack.frames[i].cells);
+    free(stack.frames);
+    return catalog->head;
+}
+
+static void write_table(Table *table, const char *dir) {
+    if (table->spill) {
+        finish_spill(table, dir);
+        return;
+    }
+    char *path = table_path(dir, table, ".csv");
+    CsvWriter *out = open_csv(path, csv_open);
+    free(path);
+    write_header(out, table);
+    write_rows(out, table);
+    table->csv_bytes = csv_close(out);
+}
+
+void write_csv(Table *table, const char *dir) {
+    for (; table; table = table->next) write_table(table, dir);
+}
+
+// Tables waiting for a worker of write_csv_parallel
+typedef struct table_queue {
+    Table **tables;
+    int count;
+    int next;
+    const char *dir;
+    pthread_mutex_t lock;
+} TableQueue;
+
+static void *csv_worker(void *arg) {
+    TableQueue *queue = arg;
+    for (;;) {
+        pthread_mutex_lock(&queue->lock);
+        int i = queue->next++;
+        pthread_mutex_unlock(&queue->lock);
+        if (i >= queue->count) return NULL;
+        write_table(queue->tables[i], queue->dir);
     }
 }
 
+// Largest first, so a big table is not the last one to start
+static int by_cells_desc(const void *a, const void *b) {
+    const Table *ta = *(Table *const *)a, *tb = *(Table *const *)b;
+    long ca = ta->row_count * ta->column_count, cb = tb->row_count * tb->column_count;
+    return (ca < cb) - (ca > cb);
+}
+
+// Each table is its own file, so up to jobs tables are written at once.
+// The files are the same as write_csv's.
+void write_csv_parallel(Table *table, const char *dir, int jobs) {
+    TableQueue queue;
+    queue.count = 0;
+    for (Table *t = table; t; t = t->next) queue.count++;
+    if (jobs > queue.count) jobs = queue.count;
+    if (jobs <= 1) {
+        write_csv(table, dir);
+        return;
+    }
+
+    queue.tables = malloc(queue.count * sizeof(Table *));
+    int i = 0;
+    for (Table *t = table; t; t = t->next) queue.tables[i++] = t;
+    qsort(queue.tables, queue.count, sizeof(Table *), by_cells_desc);
+    queue.next = 0;
+    queue.dir = dir;
+    pthread_mutex_init(&queue.lock, NULL);
+
+    pthread_t *workers = malloc(jobs * sizeof(pthread_t));
+    for (i = 0; i < jobs; i++) {
+        if (pthread_create(&workers[i], NULL, csv_worker, &queue) != 0) break;
+    }
+    int started = i;
+    if (started == 0) csv_worker(&queue); // No threads available: write them here
+    for (i = 0; i < started; i++) pthread_join(workers[i], NULL);
+
+    pthread_mutex_destroy(&queue.lock);
+    free(workers);
+    free(queue.tables);
+}
+
 void free_tables(Table *table) {
     while (table) {
         Table *next = table->next;
         Column *c = table->columns;
         while (c) {
             Column *next_c = c->next;
-            free(c->name);
+            free(c->types);
+            free(c->values);
             free(c);
             c = next_c;
         }
-        Row *r = table->rows;
-        while (r) {
-            Row *next_r = r->next;
-            int value_count = r->value_count;
-            for (int i = 0; i < value_count; i++) {
-                if (r->values[i]) {
-                    free(r->values[i]);
-                    r->values[i] = NULL;
-                }
+        free(table->column_at);
+        arena_free(&table->strings);
+        if (table->spill) {
+            SpillSpan *span = table->spill->spans;
+            while (span) {
+                SpillSpan *next_span = span->next;
+                free(span);
+                span = next_span;
             }
-            free(r->values);
-            free(r);
-            r = next_r;
+            free(table->spill);
         }
-        free(table->name);
+        free(table->column_map);
+        free(table->shape.keys);
+        free(table->shape.slots);
         free(table);
         table = next;
     }
@@ -3,29 +3,140 @@
 
 #include "ast.h"
 
+// Tables are stored by column: each column keeps one type byte and one
+// 8-byte value per row, so a cell costs 9 bytes and no allocation of its own.
+// Text of up to 8 bytes is kept in the value itself, longer text in the
+// table's string arena.
+typedef enum {
+    CELL_EMPTY,     // Missing or null
+    CELL_INT,       // Ids, indexes and long numbers written as plain integers
+    CELL_TEXT,      // Strings, and numbers kept as written
+    CELL_TRUE,
+    CELL_FALSE,
+    CELL_SHORT      // Text in the value: the type is CELL_SHORT plus its length
+} CellType;
+
+#define CELL_SHORT_MAX 8
+
+typedef union cell_value {
+    int64_t i;
+    const char *text;
+    char bytes[CELL_SHORT_MAX]; // CELL_SHORT, not NUL-terminated
+} CellValue;
+
+// A cell on its own, for a row that is still being filled
+typedef struct cell {
+    CellType type;
+    CellValue value;
+} Cell;
+
+// --schema: the values a declared column takes; null fits any of them
+typedef enum {
+    COLUMN_ANY,
+    COLUMN_STRING,
+    COLUMN_NUMBER,
+    COLUMN_INTEGER,   // Numbers written without a fraction or exponent
+    COLUMN_BOOLEAN
+} ColumnType;
+
 typedef struct column {
-    char *name;
+    const char *name; // Interned
     struct column *next;
+    uint8_t *types;   // CellType of each row; rows from before the column are empty
+    CellValue *values;
+    ColumnType type;  // As declared by --schema, otherwise any
 } Column;
 
-typedef struct row {
-    int id;
-    char **values;
-    int value_count; // Added to track values size
-    struct row *next;
-} Row;
+// Slot of a table's column map; open addressing on the interned name
+typedef struct column_slot {
+    const char *name; // NULL when empty
+    int index;
+} ColumnSlot;
+
+// Key sequence of the last object filled into a table, with the column of
+// each key (-1 if the key has no column)
+typedef struct shape {
+    const char **keys;
+    int *slots;
+    int count;
+    int cap;
+} Shape;
+
+// Walks one object's keys against its table's shape
+typedef struct shape_cursor {
+    int pos;
+    int diverged;
+} ShapeCursor;
 
 typedef struct table {
-    char *name;
+    const char *name; // Interned, unique within the catalog
     Column *columns;
-    Row *rows;
+    Column *last_column;
+    int column_count;
+    ColumnSlot *column_map;
+    int column_map_size;
+    Shape shape;
+    Column **column_at;          // By index
+    long row_count;
+    long row_cap;                // Rows each column has room for
+    Arena strings;               // Text of the cells
+    size_t text_bytes;           // Put in strings since the last spill
+    size_t csv_bytes;            // Size of its file, once written
+    struct stream_table *stream; // Spool state in stream mode (stream.c)
+    struct spill *spill;         // Rows already in its file (--max-memory)
     struct table *next;
 } Table;
 
-Table *create_table(const char *name, AstNode *node);
-Table *create_tables(AstNode *node);
+// Receives each finished row of table when rows are streamed instead of kept.
+// values[i] is the cell of the table's i-th column (NULL if empty); columns
+// are only ever appended, so value_count may be less than column_count.
+typedef void (*RowCallback)(const Table *table, char *const *values, int value_count, void *user);
+
+// Called for each table once its file is complete
+typedef void (*TableCallback)(const Table *table, void *user);
+
+// Tables by name; head links them all through next, in creation order.
+// Also hands out the row ids of the objects written into its tables.
+typedef struct catalog {
+    Table *head;
+    Table *tail;
+    Table **map;
+    int size;
+    int count;
+    int last_id;
+    // --max-memory: create_tables appends a table's rows to dir/<name>.csv
+    // once they take more than max_memory / count bytes (0: no limit)
+    size_t max_memory;
+    const char *spill_dir;
+} Catalog;
+
+Table *catalog_table(Catalog *catalog, const char *name);
+Table *catalog_find(Catalog *catalog, const char *name); // NULL if it has none
+void catalog_clear(Catalog *catalog);
+
+Table *new_table(const char *name);
+// Column names are interned keys (see intern.h)
+void add_column_if_missing(Table *table, const char *col_name);
+int column_index(Table *table, const char *col_name);
+int shape_column(Table *table, ShapeCursor *cursor, const char *key);
+void shape_set_column(Table *table, ShapeCursor *cursor, const char *key, int idx);
+char *format_scalar(const AstNode *value);
+char *format_id(int id);
+// Cells for add_row(); text is copied into the table
+Cell scalar_cell(Table *table, const AstNode *value);
+Cell text_cell(Table *table, const char *text);
+// Appends a row of count cells, one per column from the first; columns
+// beyond count are left empty. Returns the row's index.
+long add_row(Table *table, const Cell *cells, int count);
+// Text of a cell as it goes in the CSV, NULL if empty; buf (21 bytes) holds
+// the digits of an integer
+const char *table_cell(const Table *table, const Column *column, long row, char *buf);
+long table_rows(const Table *table); // Including rows already spilled
+int next_row_id(Catalog *catalog);
+// Fills catalog with the tables of a document; returns catalog->head
+Table *create_tables(Catalog *catalog, const Ast *ast, NodeId root);
 void write_csv(Table *table, const char *dir);
+void write_csv_parallel(Table *table, const char *dir, int jobs);
 void free_tables(Table *table);
-void free_all_tables(void); // Added
 
 #endif
\ No newline at end of file
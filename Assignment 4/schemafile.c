@@ -0,0 +1,64 @@
+#include "schemafile.h"
+#include "context.h"
+#include "scanner.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *type_names[] = { "any", "string", "number", "integer", "boolean" };
+
+// The ColumnType called name, or -1
+static int column_type(const char *name) {
+    for (int i = 0; i < (int)(sizeof(type_names) / sizeof(type_names[0])); i++) {
+        if (strcmp(name, type_names[i]) == 0) return i;
+    }
+    return -1;
+}
+
+// Declare the columns of one table, an object of name: type pairs
+static int add_table(Catalog *catalog, const Ast *ast, const AstNode *node, char *error, size_t error_size) {
+    const char *name = node_key(node);
+    if (node_type(node) != NODE_OBJECT) {
+        snprintf(error, error_size, "table %s is not an object of columns", name);
+        return 1;
+    }
+    Table *table = catalog_table(catalog, name);
+    for (NodeId m = node->data.first; m; m = ast->nodes[m].next) {
+        const AstNode *column = &ast->nodes[m];
+        int type = node_type(column) == NODE_STRING ? column_type(column->data.string) : -1;
+        if (type < 0) {
+            snprintf(error, error_size, "column %s.%s needs a type: string, number, integer, boolean or any",
+                     name, node_key(column));
+            return 1;
+        }
+        add_column_if_missing(table, node_key(column));
+        table->column_at[column_index(table, node_key(column))]->type = type;
+    }
+    return 0;
+}
+
+int load_schema(const char *path, Catalog *catalog, char *error, size_t error_size) {
+    J2RContext ctx;
+    j2r_init(&ctx);
+    ctx.scanner = scanner_open(path, 0);
+    if (!ctx.scanner) {
+        snprintf(error, error_size, "cannot be opened");
+        return 1;
+    }
+    if (j2r_parse(&ctx, 0) != 0) {
+        snprintf(error, error_size, "%s", ctx.error);
+        j2r_free(&ctx);
+        return 1;
+    }
+
+    const AstNode *root = &ctx.ast.nodes[ctx.ast.root];
+    int status = 0;
+    if (node_type(root) != NODE_OBJECT) {
+        snprintf(error, error_size, "expected an object of tables");
+        status = 1;
+    }
+    for (NodeId t = root->data.first; !status && t; t = ctx.ast.nodes[t].next) {
+        status = add_table(catalog, &ctx.ast, &ctx.ast.nodes[t], error, error_size);
+    }
+    j2r_free(&ctx);
+    return status;
+}
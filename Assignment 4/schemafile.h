@@ -0,0 +1,20 @@
+#ifndef SCHEMAFILE_H
+#define SCHEMAFILE_H
+
+#include <stddef.h>
+#include "schema.h"
+
+// --schema: the tables and columns of the output, declared in a JSON file
+// instead of found in the input. An object of tables, each an object of
+// its columns in file order with the type of their values:
+//
+//   { "table_name": { "id": "integer", "name": "string", "tags": "any" },
+//     "tags": { "table_name_id": "integer", "index": "integer", "value": "string" } }
+//
+// Types are string, number, integer, boolean or any. Tables and columns
+// are named as json2relcsv would name them.
+//
+// Adds the tables to catalog. Returns 0, or 1 with the reason in error.
+int load_schema(const char *path, Catalog *catalog, char *error, size_t error_size);
+
+#endif
@@ -0,0 +1,123 @@
+#include "stats.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+static const char *phase_names[PHASE_COUNT] = { "schema", "parse", "tables", "write", "teardown" };
+static const char *node_names[NODE_TYPES] = { "object", "array", "string", "number", "bool", "null" };
+
+static double seconds_since(struct timespec *mark, clockid_t clock) {
+    struct timespec now;
+    clock_gettime(clock, &now);
+    double s = (now.tv_sec - mark->tv_sec) + (now.tv_nsec - mark->tv_nsec) / 1e9;
+    *mark = now;
+    return s;
+}
+
+void stats_start(Stats *stats) {
+    memset(stats, 0, sizeof(Stats));
+    clock_gettime(CLOCK_MONOTONIC, &stats->wall_mark);
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &stats->cpu_mark);
+}
+
+void stats_phase(Stats *stats, Phase phase) {
+    stats->wall[phase] += seconds_since(&stats->wall_mark, CLOCK_MONOTONIC);
+    stats->cpu[phase] += seconds_since(&stats->cpu_mark, CLOCK_PROCESS_CPUTIME_ID);
+}
+
+void stats_table(const Table *table, void *user) {
+    Stats *stats = user;
+    if (stats->table_count == stats->table_cap) {
+        stats->table_cap = stats->table_cap ? stats->table_cap * 2 : 16;
+        stats->tables = realloc(stats->tables, stats->table_cap * sizeof(TableStats));
+    }
+    stats->tables[stats->table_count++] = (TableStats){ strdup(table->name), table_rows(table), table->csv_bytes };
+    stats->bytes_out += table->csv_bytes;
+}
+
+void stats_nodes(Stats *stats, const Ast *ast) {
+    memcpy(stats->nodes, ast->created, sizeof(stats->nodes));
+}
+
+static long peak_rss_kb(void) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return usage.ru_maxrss; // KB on Linux
+}
+
+// Table names are keys as they were written between quotes in the input, so
+// they are already JSON apart from raw control characters
+static void print_json_name(FILE *out, const char *name) {
+    fputc('"', out);
+    for (const unsigned char *p = (const unsigned char *)name; *p; p++) {
+        if (*p < 0x20) fprintf(out, "\\u%04x", *p);
+        else fputc(*p, out);
+    }
+    fputc('"', out);
+}
+
+static void print_json(const Stats *stats, FILE *out) {
+    double wall = 0, cpu = 0;
+    fprintf(out, "{\"phases\":{");
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        fprintf(out, "%s\"%s\":{\"wall_ms\":%.3f,\"cpu_ms\":%.3f}", i ? "," : "",
+                phase_names[i], stats->wall[i] * 1e3, stats->cpu[i] * 1e3);
+        wall += stats->wall[i];
+        cpu += stats->cpu[i];
+    }
+    fprintf(out, "},\"total\":{\"wall_ms\":%.3f,\"cpu_ms\":%.3f}", wall * 1e3, cpu * 1e3);
+    fprintf(out, ",\"bytes_in\":%zu,\"bytes_out\":%zu,\"nodes\":{", stats->bytes_in, stats->bytes_out);
+    uint64_t nodes = 0;
+    for (int i = 0; i < NODE_TYPES; i++) {
+        fprintf(out, "%s\"%s\":%llu", i ? "," : "", node_names[i], (unsigned long long)stats->nodes[i]);
+        nodes += stats->nodes[i];
+    }
+    fprintf(out, ",\"total\":%llu},\"tables\":[", (unsigned long long)nodes);
+    for (int i = 0; i < stats->table_count; i++) {
+        const TableStats *t = &stats->tables[i];
+        fprintf(out, "%s{\"name\":", i ? "," : "");
+        print_json_name(out, t->name);
+        fprintf(out, ",\"rows\":%ld,\"bytes\":%zu}", t->rows, t->bytes);
+    }
+    fprintf(out, "],\"peak_rss_kb\":%ld}\n", peak_rss_kb());
+}
+
+static void print_text(const Stats *stats, FILE *out) {
+    double wall = 0, cpu = 0;
+    fprintf(out, "%-10s %12s %12s\n", "phase", "wall ms", "cpu ms");
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        fprintf(out, "%-10s %12.1f %12.1f\n", phase_names[i], stats->wall[i] * 1e3, stats->cpu[i] * 1e3);
+        wall += stats->wall[i];
+        cpu += stats->cpu[i];
+    }
+    fprintf(out, "%-10s %12.1f %12.1f\n\n", "total", wall * 1e3, cpu * 1e3);
+
+    fprintf(out, "%-10s %12zu bytes\n", "input", stats->bytes_in);
+    fprintf(out, "%-10s %12zu bytes\n", "output", stats->bytes_out);
+    uint64_t nodes = 0;
+    for (int i = 0; i < NODE_TYPES; i++) nodes += stats->nodes[i];
+    fprintf(out, "%-10s %12llu  (", "nodes", (unsigned long long)nodes);
+    for (int i = 0; i < NODE_TYPES; i++) {
+        fprintf(out, "%s%s %llu", i ? ", " : "", node_names[i], (unsigned long long)stats->nodes[i]);
+    }
+    fprintf(out, ")\n");
+    fprintf(out, "%-10s %12ld KB\n", "peak RSS", peak_rss_kb());
+    fprintf(out, "%-10s %12d\n", "tables", stats->table_count);
+    for (int i = 0; i < stats->table_count; i++) {
+        const TableStats *t = &stats->tables[i];
+        fprintf(out, "  %-30s %12ld rows %14zu bytes\n", t->name, t->rows, t->bytes);
+    }
+}
+
+void stats_print(const Stats *stats, FILE *out, int json) {
+    if (json) print_json(stats, out);
+    else print_text(stats, out);
+}
+
+void stats_free(Stats *stats) {
+    for (int i = 0; i < stats->table_count; i++) free(stats->tables[i].name);
+    free(stats->tables);
+    stats->tables = NULL;
+    stats->table_count = 0;
+    stats->table_cap = 0;
+}
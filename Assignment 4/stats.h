@@ -0,0 +1,49 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include <time.h>
+#include "ast.h"
+#include "schema.h"
+
+// --stats: where a run's time and memory went. Each phase gets its wall time
+// and the process's CPU time (all threads), and the run's input and output
+// sizes, nodes, tables and peak RSS are reported with them.
+
+typedef enum {
+    PHASE_SCHEMA,   // --two-pass: the first pass over the input
+    PHASE_PARSE,    // Scanning and yyparse(); in stream modes also the rows
+    PHASE_TABLES,   // create_tables()
+    PHASE_WRITE,    // write_csv_parallel(), or finishing the streamed files
+    PHASE_TEARDOWN, // Freeing the tables, the document and the keys
+    PHASE_COUNT
+} Phase;
+
+typedef struct table_stats {
+    char *name; // A copy: the keys are gone by the time stats are printed
+    long rows;
+    size_t bytes;
+} TableStats;
+
+typedef struct stats {
+    struct timespec wall_mark;  // End of the last phase
+    struct timespec cpu_mark;
+    double wall[PHASE_COUNT];   // Seconds
+    double cpu[PHASE_COUNT];
+    size_t bytes_in;
+    size_t bytes_out;
+    uint64_t nodes[NODE_TYPES];
+    TableStats *tables;
+    int table_count;
+    int table_cap;
+} Stats;
+
+void stats_start(Stats *stats);
+void stats_phase(Stats *stats, Phase phase); // Time since the last mark goes to phase
+void stats_table(const Table *table, void *stats); // A TableCallback
+void stats_nodes(Stats *stats, const Ast *ast);
+// Human-readable, or one JSON object on one line
+void stats_print(const Stats *stats, FILE *out, int json);
+void stats_free(Stats *stats);
+
+#endif
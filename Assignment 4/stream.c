@@ -0,0 +1,733 @@
+#include "stream.h"
+#include "schema.h"
+#include "intern.h"
+#include "csv.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+// Spools kept open at once, and at most half the descriptors the process may
+// have; the least recently written one is closed to make room, and opened
+// again to append when it gets another row
+#define STREAM_OPEN_MAX 256
+
+// Rows spooled while a table had a given number of columns. Columns are only
+// ever appended, so older rows get empty trailing cells when the file is closed.
+typedef struct span {
+    int col_count;
+    long rows;
+    struct span *next;
+} Span;
+
+typedef struct stream_table {
+    Table *table;           // name and columns, rows go straight to the spool
+    char *spool_path;
+    CsvWriter *spool;       // NULL while closed
+    size_t spool_bytes;     // Written before it was last closed
+    int fixed;              // --two-pass or --schema: the spool is the file
+    int header_columns;     // itself, its header already written
+    Span *spans;
+    Span *last_span;
+    struct stream_table *next;
+    struct stream_table *newer; // Open spools, by when they were last written
+    struct stream_table *older;
+} StreamTable;
+
+typedef enum {
+    ARRAY_EMPTY,
+    ARRAY_OF_OBJECTS,
+    ARRAY_OF_VALUES
+} ArrayKind;
+
+// One object or array that is still open
+typedef struct frame {
+    NodeType type;
+    int tabled;             // 0 when nothing below this value produces rows
+    Table *table;
+    // objects
+    int id;
+    char **values;          // pending row, indexed by column
+    int value_cap;
+    const char *key;        // key of the pair being parsed (interned)
+    int slot;               // its column, -1 if it has none yet
+    ShapeCursor cursor;
+    // arrays
+    const char *name;
+    const char *fk_col;
+    const char *parent_name;
+    int parent_id;
+    ArrayKind kind;
+    int index;
+} Frame;
+
+// Turns one sequence of values into rows. A writer from stream_open spools
+// rows to out_dir; an NDJSON worker's writer (out_dir NULL) keeps them on
+// its tables until stream_merge. Row ids come from the catalog.
+struct stream_writer {
+    Catalog catalog;
+    const char *out_dir;
+    RowCallback on_row;     // instead of out_dir
+    void *user;
+    Ast *ast;               // released by the parser hooks, NULL in record mode
+    int schema_only;        // --two-pass, first pass: tables and columns, no rows
+    int declared;           // --schema: no tables or columns are added
+    long dropped;           // Values with no place in the declared schema
+    StreamTable *spools;
+    StreamTable *newest;    // Open spools, most recently written first
+    StreamTable *oldest;
+    int open_spools;
+    int max_open_spools;
+    Frame *stack;
+    int depth;
+    int stack_cap;
+};
+
+static StreamWriter *new_writer(const char *dir, Ast *ast) {
+    StreamWriter *w = calloc(1, sizeof(StreamWriter));
+    w->out_dir = dir;
+    w->ast = ast;
+    w->max_open_spools = STREAM_OPEN_MAX;
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur / 2 < STREAM_OPEN_MAX) {
+        w->max_open_spools = limit.rlim_cur > 2 ? limit.rlim_cur / 2 : 1;
+    }
+    return w;
+}
+
+StreamWriter *stream_open(const char *dir, Ast *ast) {
+    return new_writer(dir, ast);
+}
+
+StreamWriter *stream_open_callback(RowCallback on_row, void *user, Ast *ast) {
+    StreamWriter *w = new_writer(NULL, ast);
+    w->on_row = on_row;
+    w->user = user;
+    return w;
+}
+
+StreamWriter *stream_open_schema(Ast *ast) {
+    StreamWriter *w = new_writer(NULL, ast);
+    w->schema_only = 1;
+    return w;
+}
+
+StreamWriter *stream_open_declared(Catalog *declared) {
+    StreamWriter *w = new_writer(NULL, NULL);
+    w->catalog = *declared;
+    memset(declared, 0, sizeof(Catalog));
+    w->declared = 1;
+    return w;
+}
+
+StreamWriter *stream_open_records(const char *dir) {
+    // Names every worker looks up; the rest come from count_ids
+    intern_key("id");
+    intern_key("index");
+    intern_key("value");
+    return new_writer(dir, NULL);
+}
+
+// Close every spool and delete the files: nothing is left behind when a
+// conversion fails
+static void discard_spools(StreamWriter *w) {
+    for (StreamTable *st = w->spools; st; st = st->next) {
+        if (st->spool) csv_close(st->spool);
+        st->spool = NULL;
+        remove(st->spool_path);
+    }
+    w->newest = w->oldest = NULL;
+    w->open_spools = 0;
+}
+
+static void unlink_open(StreamWriter *w, StreamTable *st) {
+    if (st->newer) st->newer->older = st->older;
+    else w->newest = st->older;
+    if (st->older) st->older->newer = st->newer;
+    else w->oldest = st->newer;
+    st->newer = st->older = NULL;
+}
+
+static void close_spool(StreamWriter *w, StreamTable *st) {
+    unlink_open(w, st);
+    st->spool_bytes += csv_close(st->spool);
+    st->spool = NULL;
+    w->open_spools--;
+}
+
+// The spool of st, opened again if it was closed, for writing a row
+static CsvWriter *spool(StreamWriter *w, StreamTable *st) {
+    if (st->spool) {
+        if (w->newest == st) return st->spool;
+        unlink_open(w, st);
+    } else {
+        if (w->open_spools == w->max_open_spools) close_spool(w, w->oldest);
+        st->spool = csv_open_small(st->spool_path, 1);
+        if (!st->spool) {
+            fprintf(stderr, "Error opening %s\n", st->spool_path);
+            discard_spools(w);
+            exit(1);
+        }
+        w->open_spools++;
+    }
+    st->older = w->newest;
+    if (w->newest) w->newest->newer = st;
+    else w->oldest = st;
+    w->newest = st;
+    return st->spool;
+}
+
+// Start writing table to dir/<name><suffix>: its spool, or if fixed its file
+static void open_spool(StreamWriter *w, Table *table, const char *suffix, int fixed) {
+    StreamTable *st = calloc(1, sizeof(StreamTable));
+    st->table = table;
+    size_t len = strlen(w->out_dir) + strlen(table->name) + 16;
+    st->spool_path = malloc(len);
+    snprintf(st->spool_path, len, "%s/%s%s", w->out_dir, table->name, suffix);
+    st->next = w->spools;
+    w->spools = st;
+    table->stream = st;
+    // Created empty now; rows are appended through spool()
+    CsvWriter *out = csv_open_small(st->spool_path, 0);
+    if (!out) {
+        fprintf(stderr, "Error opening %s\n", st->spool_path);
+        discard_spools(w);
+        exit(1);
+    }
+    csv_close(out);
+    st->fixed = fixed;
+    st->header_columns = table->column_count;
+}
+
+// Table called name (interned); a spooling writer opens its spool on first use.
+// With a declared schema, NULL if it has no such table.
+static Table *stream_table(StreamWriter *w, const char *name) {
+    if (w->declared) {
+        Table *table = catalog_find(&w->catalog, name);
+        if (!table) w->dropped++;
+        return table;
+    }
+    Table *table = catalog_table(&w->catalog, name);
+    if (w->out_dir && !table->stream) open_spool(w, table, ".csv.part", 0);
+    return table;
+}
+
+static void write_row(StreamWriter *w, StreamTable *st, char **values, int value_count) {
+    CsvWriter *out = spool(w, st);
+    int col_count = st->table->column_count;
+    for (int i = 0; i < col_count; i++) csv_field(out, i < value_count ? values[i] : NULL);
+    csv_end_row(out);
+    st->table->row_count++;
+
+    if (!st->last_span || st->last_span->col_count != col_count) {
+        Span *span = malloc(sizeof(Span));
+        span->col_count = col_count;
+        span->rows = 0;
+        span->next = NULL;
+        if (st->last_span) st->last_span->next = span;
+        else st->spans = span;
+        st->last_span = span;
+    }
+    st->last_span->rows++;
+}
+
+// Index of table's column called name, added if missing; with a declared
+// schema, -1 if the table has no such column
+static int table_column(StreamWriter *w, Table *table, const char *name) {
+    if (!w->declared) add_column_if_missing(table, name);
+    return column_index(table, name);
+}
+
+// Whether a declared column takes a scalar
+static int column_fits(const Table *table, int idx, const AstNode *value) {
+    switch (table->column_at[idx]->type) {
+        case COLUMN_STRING: return node_type(value) == NODE_STRING || node_type(value) == NODE_NULL;
+        case COLUMN_NUMBER: return node_type(value) == NODE_NUMBER || node_type(value) == NODE_NULL;
+        case COLUMN_INTEGER:
+            if (node_type(value) == NODE_NULL) return 1;
+            return node_type(value) == NODE_NUMBER && !strpbrk(value->data.digits, ".eE");
+        case COLUMN_BOOLEAN: return node_type(value) == NODE_BOOL || node_type(value) == NODE_NULL;
+        default: return 1;
+    }
+}
+
+// A finished row; takes the values array
+static void emit_row(StreamWriter *w, Table *table, char **values, int value_count) {
+    if (w->out_dir || w->on_row) {
+        if (w->out_dir) write_row(w, table->stream, values, value_count);
+        else w->on_row(table, values, value_count < table->column_count ? value_count : table->column_count, w->user);
+        for (int i = 0; i < value_count; i++) free(values[i]);
+        free(values);
+        return;
+    }
+    Cell *cells = malloc((value_count ? value_count : 1) * sizeof(Cell));
+    for (int i = 0; i < value_count; i++) {
+        cells[i] = values[i] ? text_cell(table, values[i]) : (Cell){ CELL_EMPTY };
+        free(values[i]);
+    }
+    add_row(table, cells, value_count);
+    free(cells);
+    free(values);
+}
+
+static Frame *push_frame(StreamWriter *w, NodeType type) {
+    if (w->depth == w->stack_cap) {
+        w->stack_cap = w->stack_cap ? w->stack_cap * 2 : 16;
+        w->stack = realloc(w->stack, w->stack_cap * sizeof(Frame));
+    }
+    Frame *f = &w->stack[w->depth++];
+    memset(f, 0, sizeof(Frame));
+    f->type = type;
+    return f;
+}
+
+static void pop_frame(StreamWriter *w) {
+    Frame *f = &w->stack[--w->depth];
+    for (int i = 0; i < f->value_cap; i++) free(f->values[i]);
+    free(f->values);
+}
+
+static void set_value(Frame *f, int idx, char *value) {
+    if (idx >= f->value_cap) {
+        int cap = f->value_cap ? f->value_cap : 8;
+        while (cap <= idx) cap *= 2;
+        f->values = realloc(f->values, cap * sizeof(char *));
+        memset(f->values + f->value_cap, 0, (cap - f->value_cap) * sizeof(char *));
+        f->value_cap = cap;
+    }
+    free(f->values[idx]);
+    f->values[idx] = value;
+}
+
+// Array of primitives: <parent>_id, index, value
+static void write_value_row(StreamWriter *w, Frame *array, const AstNode *value) {
+    Table *table = array->table;
+    int col_count = table->column_count;
+    char **row = calloc(col_count, sizeof(char *));
+    int fk_idx = column_index(table, array->fk_col);
+    int index_idx = column_index(table, intern_key("index"));
+    int value_idx = column_index(table, intern_key("value"));
+
+    if (fk_idx >= 0) row[fk_idx] = format_id(array->parent_id);
+    if (index_idx >= 0) row[index_idx] = format_id(array->index);
+    if (value) {
+        if (value_idx >= 0 && column_fits(table, value_idx, value)) row[value_idx] = format_scalar(value);
+        else w->dropped++;
+    }
+    emit_row(w, table, row, col_count);
+}
+
+// Foreign key column of an array of primitives
+static const char *fk_column(const char *parent_name) {
+    char fk_col[128];
+    if (parent_name && strlen(parent_name) > 0) {
+        snprintf(fk_col, sizeof(fk_col), "%s_id", parent_name);
+    } else {
+        snprintf(fk_col, sizeof(fk_col), "parent_id");
+    }
+    return intern_key(fk_col);
+}
+
+// Every element of a tabled array goes through here; the first one decides
+// what kind of table the array becomes
+static void array_element(StreamWriter *w, Frame *array, NodeType type, const AstNode *value) {
+    if (array->kind == ARRAY_EMPTY) {
+        array->table = stream_table(w, array->name);
+        if (!array->table) {
+            array->tabled = 0;
+            return;
+        }
+        if (type == NODE_OBJECT) {
+            array->kind = ARRAY_OF_OBJECTS;
+            table_column(w, array->table, intern_key("id"));
+        } else {
+            array->kind = ARRAY_OF_VALUES;
+            array->fk_col = fk_column(array->parent_name);
+            table_column(w, array->table, array->fk_col);
+            table_column(w, array->table, intern_key("index"));
+            table_column(w, array->table, intern_key("value"));
+        }
+    }
+    if (array->kind == ARRAY_OF_VALUES && !w->schema_only) write_value_row(w, array, value);
+    array->index++;
+}
+
+// The current key of an object gets a column (unless the schema is declared)
+static void add_key_column(StreamWriter *w, Frame *f) {
+    f->slot = table_column(w, f->table, f->key);
+    shape_set_column(f->table, &f->cursor, f->key, f->slot);
+}
+
+static void begin_object(StreamWriter *w) {
+    Frame *f = push_frame(w, NODE_OBJECT);
+    Frame *parent = w->depth > 1 ? &w->stack[w->depth - 2] : NULL;
+
+    if (!parent) {
+        f->table = stream_table(w, intern_key("table_name"));
+    } else if (parent->tabled && parent->type == NODE_OBJECT) {
+        f->table = stream_table(w, parent->key);
+    } else if (parent->tabled) {
+        array_element(w, parent, NODE_OBJECT, NULL);
+        if (parent->kind == ARRAY_OF_OBJECTS) f->table = parent->table;
+    }
+    if (!f->table) return;
+
+    f->tabled = 1;
+    int id_idx = table_column(w, f->table, intern_key("id"));
+    if (!w->schema_only) {
+        f->id = next_row_id(&w->catalog);
+        if (id_idx >= 0) set_value(f, id_idx, format_id(f->id));
+    }
+
+    // Nested object: the parent row stores its id
+    if (parent && parent->type == NODE_OBJECT) {
+        if (parent->slot < 0) add_key_column(w, parent);
+        if (w->schema_only) return;
+        if (parent->slot >= 0) set_value(parent, parent->slot, format_id(f->id));
+        else w->dropped++;
+    }
+}
+
+static void begin_array(StreamWriter *w) {
+    Frame *f = push_frame(w, NODE_ARRAY);
+    Frame *parent = w->depth > 1 ? &w->stack[w->depth - 2] : NULL;
+
+    if (!parent) {
+        f->tabled = 1;
+        f->name = intern_key("table_name");
+    } else if (parent->tabled && parent->type == NODE_OBJECT) {
+        f->tabled = 1;
+        f->name = parent->key;
+        f->parent_name = parent->table->name;
+        f->parent_id = parent->id;
+    } else if (parent->tabled) {
+        // Nested arrays only count as an (empty) element of their parent
+        array_element(w, parent, NODE_ARRAY, NULL);
+    }
+}
+
+static void object_key(StreamWriter *w, const char *key) {
+    Frame *f = &w->stack[w->depth - 1];
+    f->key = key;
+    if (f->tabled) f->slot = shape_column(f->table, &f->cursor, f->key);
+}
+
+static void scalar_value(StreamWriter *w, const AstNode *node) {
+    Frame *f = w->depth > 0 ? &w->stack[w->depth - 1] : NULL;
+    if (f && f->tabled) {
+        if (f->type == NODE_OBJECT) {
+            if (f->slot < 0) add_key_column(w, f);
+            if (w->schema_only) return;
+            if (f->slot >= 0 && column_fits(f->table, f->slot, node)) set_value(f, f->slot, format_scalar(node));
+            else w->dropped++;
+        } else {
+            array_element(w, f, node_type(node), node);
+        }
+    }
+}
+
+static void end_object(StreamWriter *w) {
+    Frame *f = &w->stack[w->depth - 1];
+    if (f->tabled && !w->schema_only) {
+        emit_row(w, f->table, f->values, f->value_cap);
+        f->values = NULL;
+        f->value_cap = 0;
+    }
+    pop_frame(w);
+}
+
+static void end_array(StreamWriter *w) {
+    pop_frame(w);
+}
+
+// Parser hooks: they drive the writer and release the AST built so far.
+// Without a writer, or with one in record mode, they do nothing.
+
+void stream_begin_object(StreamWriter *w) {
+    if (w && w->ast) begin_object(w);
+}
+
+void stream_begin_array(StreamWriter *w) {
+    if (w && w->ast) begin_array(w);
+}
+
+void stream_key(StreamWriter *w, const char *key) {
+    if (w && w->ast) object_key(w, key);
+}
+
+NodeId stream_value(StreamWriter *w, NodeId node) {
+    if (!w || !w->ast) return node;
+    scalar_value(w, &w->ast->nodes[node]);
+    reset_ast(w->ast);
+    return 0;
+}
+
+NodeId stream_end_object(StreamWriter *w, NodeId node) {
+    if (!w || !w->ast) return node;
+    end_object(w);
+    reset_ast(w->ast);
+    return 0;
+}
+
+NodeId stream_end_array(StreamWriter *w, NodeId node) {
+    if (!w || !w->ast) return node;
+    end_array(w);
+    reset_ast(w->ast);
+    return 0;
+}
+
+// A value still to be visited by count_ids, or being replayed by stream_record
+typedef struct walk_item {
+    NodeId node;
+    NodeId next;            // next member or element (stream_record)
+    const char *name;       // table it is written as (count_ids)
+    const char *parent_name;
+} WalkItem;
+
+typedef struct walk {
+    WalkItem *items;
+    int depth;
+    int cap;
+} Walk;
+
+static WalkItem *push_item(Walk *walk, NodeId node, NodeId next, const char *name, const char *parent_name) {
+    if (walk->depth == walk->cap) {
+        walk->cap = walk->cap ? walk->cap * 2 : 64;
+        walk->items = realloc(walk->items, walk->cap * sizeof(WalkItem));
+    }
+    WalkItem *item = &walk->items[walk->depth++];
+    *item = (WalkItem){ node, next, name, parent_name };
+    return item;
+}
+
+// Ids a record takes when it is written by w, following begin_object and
+// begin_array. Also interns the foreign key columns the record will need,
+// so a worker writing it only ever looks keys up.
+static int count_ids(StreamWriter *w, const Ast *ast, NodeId record) {
+    const AstNode *nodes = ast->nodes;
+    Walk walk = { NULL, 0, 0 };
+    int ids = 0;
+    push_item(&walk, record, 0, intern_key("table_name"), NULL);
+    while (walk.depth > 0) {
+        WalkItem item = walk.items[--walk.depth];
+        const AstNode *node = &nodes[item.node];
+        NodeId first = node->data.first;
+        // Nothing under a table the declared schema lacks is written
+        if (w->declared && !catalog_find(&w->catalog, item.name)) continue;
+        if (node_type(node) == NODE_OBJECT) {
+            ids++;
+            for (NodeId m = first; m; m = nodes[m].next) {
+                NodeType type = node_type(&nodes[m]);
+                if (type == NODE_OBJECT || type == NODE_ARRAY) {
+                    push_item(&walk, m, 0, node_key(&nodes[m]), item.name);
+                }
+            }
+        } else if (node_type(node) == NODE_ARRAY && first) {
+            if (node_type(&nodes[first]) != NODE_OBJECT) {
+                fk_column(item.parent_name);
+                continue;
+            }
+            for (NodeId v = first; v; v = nodes[v].next) {
+                if (node_type(&nodes[v]) == NODE_OBJECT) push_item(&walk, v, 0, item.name, item.parent_name);
+            }
+        }
+    }
+    free(walk.items);
+    return ids;
+}
+
+int stream_record_ids(StreamWriter *w, const Ast *ast, NodeId record) {
+    return count_ids(w, ast, record);
+}
+
+int stream_reserve_ids(StreamWriter *w, int count) {
+    int first = w->catalog.last_id + 1;
+    w->catalog.last_id += count;
+    return first;
+}
+
+StreamWriter *stream_worker(StreamWriter *w, int first_id) {
+    StreamWriter *worker = new_writer(NULL, NULL);
+    worker->catalog.last_id = first_id - 1;
+    // A declared schema is copied, so the worker drops what w would
+    if (w->declared) {
+        worker->declared = 1;
+        for (Table *t = w->catalog.head; t; t = t->next) {
+            Table *table = catalog_table(&worker->catalog, t->name);
+            for (Column *c = t->columns; c; c = c->next) {
+                add_column_if_missing(table, c->name);
+                table->last_column->type = c->type;
+            }
+        }
+    }
+    return worker;
+}
+
+// Open the object or array node, or write a scalar
+static void replay_value(StreamWriter *w, Walk *walk, const Ast *ast, NodeId id) {
+    const AstNode *node = &ast->nodes[id];
+    switch (node_type(node)) {
+        case NODE_OBJECT:
+            begin_object(w);
+            push_item(walk, id, node->data.first, NULL, NULL);
+            break;
+        case NODE_ARRAY:
+            begin_array(w);
+            push_item(walk, id, node->data.first, NULL, NULL);
+            break;
+        default:
+            scalar_value(w, node);
+            break;
+    }
+}
+
+// Write an already built value the way the parser hooks would have
+void stream_record(StreamWriter *w, const Ast *ast, NodeId record) {
+    Walk walk = { NULL, 0, 0 };
+    replay_value(w, &walk, ast, record);
+    while (walk.depth > 0) {
+        WalkItem *item = &walk.items[walk.depth - 1];
+        NodeId next = item->next;
+        NodeType type = node_type(&ast->nodes[item->node]);
+        if (!next) {
+            if (type == NODE_OBJECT) end_object(w);
+            else end_array(w);
+            walk.depth--;
+            continue;
+        }
+        item->next = ast->nodes[next].next;
+        if (type == NODE_OBJECT) object_key(w, node_key(&ast->nodes[next]));
+        replay_value(w, &walk, ast, next);
+    }
+    free(walk.items);
+}
+
+static void free_writer(StreamWriter *w) {
+    while (w->spools) {
+        StreamTable *next = w->spools->next;
+        Span *span = w->spools->spans;
+        while (span) {
+            Span *next_span = span->next;
+            free(span);
+            span = next_span;
+        }
+        free(w->spools->spool_path);
+        free(w->spools);
+        w->spools = next;
+    }
+    free_tables(w->catalog.head);
+    catalog_clear(&w->catalog);
+    while (w->depth > 0) pop_frame(w);
+    free(w->stack);
+    free(w);
+}
+
+// Rows go straight to the files, whose headers are known from the first pass.
+// Tables the first pass missed still get a spool.
+void stream_use_schema(StreamWriter *w, StreamWriter *schema) {
+    w->catalog = schema->catalog;
+    w->catalog.last_id = 0;
+    w->declared = schema->declared;
+    memset(&schema->catalog, 0, sizeof(Catalog));
+    free_writer(schema);
+
+    for (Table *table = w->catalog.head; table; table = table->next) {
+        open_spool(w, table, ".csv", 1);
+        CsvWriter *out = spool(w, table->stream);
+        for (Column *c = table->columns; c; c = c->next) csv_field(out, c->name);
+        csv_end_row(out);
+    }
+}
+
+// Spool a worker's rows into w's tables. Workers are merged in record order,
+// and a worker's columns are added in the order it first saw them, so the
+// files come out as if w had written every record.
+void stream_merge(StreamWriter *w, StreamWriter *worker) {
+    for (Table *t = worker->catalog.head; t; t = t->next) {
+        Table *table = stream_table(w, t->name);
+        int *map = malloc((t->column_count + 1) * sizeof(int));
+        int i = 0;
+        for (Column *c = t->columns; c; c = c->next, i++) {
+            add_column_if_missing(table, c->name);
+            map[i] = column_index(table, c->name);
+        }
+
+        int col_count = table->column_count;
+        char **values = calloc(col_count, sizeof(char *));
+        char (*bufs)[21] = malloc((t->column_count + 1) * sizeof(*bufs));
+        for (long r = 0; r < t->row_count; r++) {
+            i = 0;
+            for (Column *c = t->columns; c; c = c->next, i++) {
+                values[map[i]] = (char *)table_cell(t, c, r, bufs[i]);
+            }
+            write_row(w, table->stream, values, col_count);
+        }
+        free(bufs);
+        free(values);
+        free(map);
+    }
+    w->dropped += worker->dropped;
+    free_writer(worker);
+}
+
+// Write the header, then copy the spooled rows behind it
+static void finish_table(StreamWriter *w, StreamTable *st) {
+    if (st->spool) close_spool(w, st);
+    if (st->fixed) {
+        // The first pass saw every column, unless the input changed since
+        if (st->table->column_count != st->header_columns) {
+            fprintf(stderr, "Error: %s has columns the first pass did not see\n", st->table->name);
+            discard_spools(w);
+            exit(1);
+        }
+        st->table->csv_bytes = st->spool_bytes;
+        return;
+    }
+    FILE *spool = fopen(st->spool_path, "r");
+    if (!spool) {
+        fprintf(stderr, "Error opening %s\n", st->spool_path);
+        discard_spools(w);
+        exit(1);
+    }
+
+    size_t len = strlen(w->out_dir) + strlen(st->table->name) + 16;
+    char *path = malloc(len);
+    snprintf(path, len, "%s/%s.csv", w->out_dir, st->table->name);
+    CsvWriter *out = csv_open(path);
+    if (!out) {
+        fprintf(stderr, "Error opening %s\n", path);
+        fclose(spool);
+        discard_spools(w);
+        exit(1);
+    }
+    free(path);
+
+    for (Column *c = st->table->columns; c; c = c->next) csv_field(out, c->name);
+    csv_end_row(out);
+
+    for (Span *span = st->spans; span; span = span->next) {
+        csv_copy_rows(out, spool, span->rows, st->table->column_count - span->col_count);
+    }
+    st->table->csv_bytes = csv_close(out);
+    fclose(spool);
+    remove(st->spool_path);
+}
+
+void stream_close(StreamWriter *w, TableCallback on_table, void *user) {
+    if (!w) return;
+    for (StreamTable *st = w->spools; st; st = st->next) finish_table(w, st);
+    if (w->dropped) fprintf(stderr, "Warning: %ld values outside the schema were dropped\n", w->dropped);
+    if (on_table) {
+        for (Table *t = w->catalog.head; t; t = t->next) {
+            if (t->stream) on_table(t, user);
+        }
+    }
+    free_writer(w);
+}
+
+// Parse error: drop the partial spool files
+void stream_abort(StreamWriter *w) {
+    if (!w) return;
+    discard_spools(w);
+    free_writer(w);
+}
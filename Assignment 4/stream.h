@@ -0,0 +1,55 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include "ast.h"
+#include "schema.h"
+
+// Streaming mode: the parser reports values as they complete and rows are
+// written out immediately, so only the currently open objects stay in memory.
+// The parser hooks take the conversion's writer; when it is NULL every hook
+// is a no-op and the AST is built as usual.
+
+typedef struct stream_writer StreamWriter;
+
+// Rows go to dir; the hooks release ast as they consume it
+StreamWriter *stream_open(const char *dir, Ast *ast);
+// Rows go to on_row instead, and no file is written
+StreamWriter *stream_open_callback(RowCallback on_row, void *user, Ast *ast);
+// Finish the files; on_table (may be NULL) then sees each table, in the
+// order they were created
+void stream_close(StreamWriter *w, TableCallback on_table, void *user);
+void stream_abort(StreamWriter *w);
+
+// --two-pass: a first pass over the input only learns the tables and their
+// columns (see j2r_scan_schema), with any scalar node standing for a value.
+// A writer from stream_open or stream_open_records then takes them over
+// before its first row, and frees schema.
+StreamWriter *stream_open_schema(Ast *ast);
+void stream_use_schema(StreamWriter *w, StreamWriter *schema);
+// --schema: the tables are declared instead (see schemafile.h); takes them
+// from declared. A writer given this schema adds no tables or columns and
+// drops the values that have none, or whose column is of another type;
+// stream_close warns how many there were.
+StreamWriter *stream_open_declared(Catalog *declared);
+
+void stream_begin_object(StreamWriter *w);
+void stream_begin_array(StreamWriter *w);
+void stream_key(StreamWriter *w, const char *key); // key is interned
+
+// Each returns the node for the parser to keep, or 0 once it has been
+// written and freed
+NodeId stream_value(StreamWriter *w, NodeId node);
+NodeId stream_end_object(StreamWriter *w, NodeId node);
+NodeId stream_end_array(StreamWriter *w, NodeId node);
+
+// Record mode (parallel --ndjson, see ndjson.c): the parser hooks stay off
+// and whole records are written by worker writers, each given its own range
+// of ids, then merged into the output in record order.
+StreamWriter *stream_open_records(const char *dir);
+int stream_record_ids(StreamWriter *w, const Ast *ast, NodeId record); // Ids the record will take
+int stream_reserve_ids(StreamWriter *w, int count);    // First id of the range
+StreamWriter *stream_worker(StreamWriter *w, int first_id); // Writes like w
+void stream_record(StreamWriter *worker, const Ast *ast, NodeId record);
+void stream_merge(StreamWriter *w, StreamWriter *worker); // Also frees the worker
+
+#endif
@@ -0,0 +1,502 @@
+#include "structural.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
+
+// Stage one turns each 64-byte block into bit masks (bit i is byte i) and
+// from them into the offsets of the bytes the lexer has to look at: every
+// bracket, colon and comma outside a string, every unescaped quote (so a
+// string runs from one offset to the next), and the first byte of every run
+// of other characters, which holds true/false/null, numbers or junk.
+// Stage two, structural_lex(), walks those offsets. The input is indexed a
+// window at a time so the index stays small and in cache.
+
+#define INDEX_WINDOW (64 * 1024) // Bytes indexed per refill, a multiple of 64
+#define DROP_WINDOW (8 << 20)     // Mapped bytes released at a time
+
+typedef struct block {
+    uint64_t quote;
+    uint64_t backslash;
+    uint64_t op;                // { } [ ] : ,
+    uint64_t space;             // space, tab, newline, carriage return
+} Block;
+
+typedef void (*Classifier)(const char *p, Block *b);
+
+typedef struct structural {
+    const char *buf;
+    size_t len;
+    char *owned;                // buf when the file was read instead of mapped
+    void *mapped;
+    size_t mapped_len;
+    size_t mapped_done;         // pages before this were released
+
+    // Stage one, carried from block to block
+    size_t indexed;             // bytes indexed so far
+    uint64_t prev_escaped;      // the next block starts with an escaped byte
+    uint64_t prev_in_string;    // all ones inside a string
+    uint64_t prev_scalar;       // the last byte belongs to a literal run
+
+    // Offsets of the current window, relative to index_base
+    uint32_t *index;
+    int index_count;
+    int index_pos;
+    size_t index_base;
+
+    size_t run_pos;             // literal run being lexed, up to run_end
+    size_t run_end;
+    size_t pos;                 // just after the last token
+    size_t unclosed;            // quote of a string never closed, or SIZE_MAX
+} Structural;
+
+// Byte classes for the scalar classifier and for finding the end of a run
+enum { C_QUOTE = 1, C_BACKSLASH = 2, C_OP = 4, C_SPACE = 8 };
+
+static unsigned char byte_class[256] = {
+    ['"'] = C_QUOTE, ['\\'] = C_BACKSLASH,
+    ['{'] = C_OP, ['}'] = C_OP, ['['] = C_OP, [']'] = C_OP, [':'] = C_OP, [','] = C_OP,
+    [' '] = C_SPACE, ['\t'] = C_SPACE, ['\n'] = C_SPACE, ['\r'] = C_SPACE,
+};
+
+static void classify_scalar(const char *p, Block *b) {
+    uint64_t quote = 0, backslash = 0, op = 0, space = 0;
+    for (int i = 0; i < 64; i++) {
+        unsigned c = byte_class[(unsigned char)p[i]];
+        quote |= (uint64_t)(c == C_QUOTE) << i;
+        backslash |= (uint64_t)(c == C_BACKSLASH) << i;
+        op |= (uint64_t)(c == C_OP) << i;
+        space |= (uint64_t)(c == C_SPACE) << i;
+    }
+    b->quote = quote;
+    b->backslash = backslash;
+    b->op = op;
+    b->space = space;
+}
+
+#ifdef __x86_64__
+// SSE2 is part of x86-64, so this one needs no check
+static uint64_t sse2_mask(__m128i v[4], char c) {
+    __m128i m = _mm_set1_epi8(c);
+    uint64_t r = 0;
+    for (int i = 0; i < 4; i++) r |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v[i], m)) << (16 * i);
+    return r;
+}
+
+static void classify_sse2(const char *p, Block *b) {
+    __m128i v[4];
+    for (int i = 0; i < 4; i++) v[i] = _mm_loadu_si128((const __m128i *)(p + 16 * i));
+    b->quote = sse2_mask(v, '"');
+    b->backslash = sse2_mask(v, '\\');
+    b->op = sse2_mask(v, '{') | sse2_mask(v, '}') | sse2_mask(v, '[') | sse2_mask(v, ']') |
+            sse2_mask(v, ':') | sse2_mask(v, ',');
+    b->space = sse2_mask(v, ' ') | sse2_mask(v, '\t') | sse2_mask(v, '\n') | sse2_mask(v, '\r');
+}
+
+__attribute__((target("avx2")))
+static uint64_t avx2_mask(__m256i lo, __m256i hi, char c) {
+    __m256i m = _mm256_set1_epi8(c);
+    uint32_t l = _mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, m));
+    uint32_t h = _mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, m));
+    return (uint64_t)h << 32 | l;
+}
+
+__attribute__((target("avx2")))
+static void classify_avx2(const char *p, Block *b) {
+    __m256i lo = _mm256_loadu_si256((const __m256i *)p);
+    __m256i hi = _mm256_loadu_si256((const __m256i *)(p + 32));
+    b->quote = avx2_mask(lo, hi, '"');
+    b->backslash = avx2_mask(lo, hi, '\\');
+    b->op = avx2_mask(lo, hi, '{') | avx2_mask(lo, hi, '}') | avx2_mask(lo, hi, '[') |
+            avx2_mask(lo, hi, ']') | avx2_mask(lo, hi, ':') | avx2_mask(lo, hi, ',');
+    b->space = avx2_mask(lo, hi, ' ') | avx2_mask(lo, hi, '\t') | avx2_mask(lo, hi, '\n') |
+               avx2_mask(lo, hi, '\r');
+}
+#endif
+
+static const struct kernel {
+    const char *name;
+    Classifier classify;
+} kernels[] = {
+#ifdef __x86_64__
+    { "avx2", classify_avx2 },
+    { "sse2", classify_sse2 },
+#endif
+    { "scalar", classify_scalar },
+};
+
+static const struct kernel *kernel = NULL;
+static pthread_once_t kernel_once = PTHREAD_ONCE_INIT;
+
+static int kernel_supported(const struct kernel *k) {
+#ifdef __x86_64__
+    if (k->classify == classify_avx2) return __builtin_cpu_supports("avx2");
+#endif
+    (void)k;
+    return 1;
+}
+
+// The first supported one; kernels[] is fastest first
+static void pick_kernel(void) {
+    __builtin_cpu_init();
+    for (kernel = kernels; !kernel_supported(kernel); kernel++) {}
+}
+
+const char *structural_kernel(void) {
+    pthread_once(&kernel_once, pick_kernel);
+    return kernel->name;
+}
+
+int structural_set_kernel(const char *name) {
+    pthread_once(&kernel_once, pick_kernel);
+    for (size_t i = 0; i < sizeof(kernels) / sizeof(kernels[0]); i++) {
+        if (strcmp(kernels[i].name, name) == 0 && kernel_supported(&kernels[i])) {
+            kernel = &kernels[i];
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Bytes preceded by an odd number of backslashes, carrying a run that ends
+// the previous block (the trick from simdjson)
+static uint64_t find_escaped(uint64_t backslash, uint64_t *prev_escaped) {
+    const uint64_t even_bits = 0x5555555555555555ULL;
+    backslash &= ~*prev_escaped;
+    uint64_t follows_escape = backslash << 1 | *prev_escaped;
+    uint64_t odd_starts = backslash & ~even_bits & ~follows_escape;
+    uint64_t even_sequences;
+    *prev_escaped = __builtin_add_overflow(odd_starts, backslash, &even_sequences);
+    uint64_t invert = even_sequences << 1;
+    return (even_bits ^ invert) & follows_escape;
+}
+
+// Bit i is the xor of bits 0..i: set from an opening quote up to, but not
+// including, its closing quote
+static uint64_t prefix_xor(uint64_t x) {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+// The mapping is read-only, so pages well behind the scan can go back to
+// the page cache; they fault in again unchanged if an error message or a
+// long string needs them
+static void release_mapped(Structural *s, size_t upto) {
+    if (!s->mapped || upto < s->mapped_done + 2 * DROP_WINDOW) return;
+    size_t done = upto - DROP_WINDOW;
+    done -= done % sysconf(_SC_PAGESIZE);
+    madvise((char *)s->mapped + s->mapped_done, done - s->mapped_done, MADV_DONTNEED);
+    s->mapped_done = done;
+}
+
+// Index the next window of input
+static void index_window(Structural *s) {
+    size_t start = s->indexed;
+    release_mapped(s, start);
+    size_t end = s->len - start < INDEX_WINDOW ? s->len : start + INDEX_WINDOW;
+    int count = 0;
+    for (size_t off = start; off < end; off += 64) {
+        const char *p = s->buf + off;
+        char tail[64];
+        if (end - off < 64) {
+            // Last block: pad with spaces, which add no bits
+            memset(tail, ' ', sizeof(tail));
+            memcpy(tail, p, end - off);
+            p = tail;
+        }
+        Block b;
+        kernel->classify(p, &b);
+
+        uint64_t escaped = find_escaped(b.backslash, &s->prev_escaped);
+        uint64_t quote = b.quote & ~escaped;
+        uint64_t in_string = prefix_xor(quote) ^ s->prev_in_string;
+        s->prev_in_string = (uint64_t)((int64_t)in_string >> 63);
+
+        uint64_t scalar = ~(b.op | b.space | quote | in_string);
+        uint64_t run_start = scalar & ~(scalar << 1 | s->prev_scalar);
+        s->prev_scalar = scalar >> 63;
+
+        uint64_t bits = (b.op & ~in_string) | quote | run_start;
+        uint32_t rel = off - start;
+        while (bits) {
+            s->index[count++] = rel + __builtin_ctzll(bits);
+            bits &= bits - 1;
+        }
+    }
+    s->index_base = start;
+    s->index_count = count;
+    s->index_pos = 0;
+    s->indexed = end;
+}
+
+// Index again from start, outside any string
+static void restart_index(Structural *s, size_t start) {
+    s->indexed = start;
+    s->prev_escaped = 0;
+    s->prev_in_string = 0;
+    s->prev_scalar = 0;
+    s->index_count = 0;
+    s->index_pos = 0;
+}
+
+// Offset of the next indexed byte; 0 at the end of input
+static int next_index(Structural *s, size_t *at) {
+    while (s->index_pos == s->index_count) {
+        if (s->indexed == s->len) return 0;
+        index_window(s);
+    }
+    *at = s->index_base + s->index[s->index_pos++];
+    return 1;
+}
+
+static int starts_with(const Structural *s, const char *word, size_t n) {
+    return s->run_end - s->run_pos >= n && memcmp(s->buf + s->run_pos, word, n) == 0;
+}
+
+static int is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// One token from the literal run, following the flex rules: true, false,
+// null and -?[0-9]+(\.[0-9]+)? by longest match, anything else skipped.
+// Returns 0 once a byte has been skipped.
+static int lex_run(Structural *s, YYSTYPE *lval) {
+    const char *p = s->buf;
+    size_t at = s->run_pos, end = s->run_end;
+    if (starts_with(s, "true", 4)) {
+        s->run_pos += 4;
+        s->pos = s->run_pos;
+        return TRUE;
+    }
+    if (starts_with(s, "false", 5)) {
+        s->run_pos += 5;
+        s->pos = s->run_pos;
+        return FALSE;
+    }
+    if (starts_with(s, "null", 4)) {
+        s->run_pos += 4;
+        s->pos = s->run_pos;
+        return NULL_TOKEN;
+    }
+
+    size_t i = at;
+    if (p[i] == '-') i++;
+    if (i < end && is_digit(p[i])) {
+        while (i < end && is_digit(p[i])) i++;
+        if (i + 1 < end && p[i] == '.' && is_digit(p[i + 1])) {
+            i++;
+            while (i < end && is_digit(p[i])) i++;
+        }
+        lval->text = (Lexeme){ p + at, i - at };
+        s->run_pos = i;
+        s->pos = i;
+        return NUMBER;
+    }
+
+    s->run_pos++;
+    return 0;
+}
+
+int structural_lex(YYSTYPE *lval, void *scanner) {
+    Structural *s = scanner;
+    for (;;) {
+        if (s->run_pos < s->run_end) {
+            int tok = lex_run(s, lval);
+            if (tok) return tok;
+            continue;
+        }
+
+        size_t at;
+        if (!next_index(s, &at)) {
+            s->pos = s->len;
+            return 0;
+        }
+        s->pos = at + 1;
+        switch (s->buf[at]) {
+            case '{': return LBRACE;
+            case '}': return RBRACE;
+            case '[': return LBRACK;
+            case ']': return RBRACK;
+            case ':': return COLON;
+            case ',': return COMMA;
+            case '"': {
+                // Nothing inside a string is indexed: the next offset closes it
+                size_t end;
+                if (!next_index(s, &end)) {
+                    // Never closed: as in flex, the quote is junk and what
+                    // follows it is lexed as tokens
+                    s->unclosed = at;
+                    restart_index(s, at + 1);
+                    continue;
+                }
+                lval->text = (Lexeme){ s->buf + at + 1, end - at - 1 };
+                s->pos = end + 1;
+                return STRING;
+            }
+            default: {
+                // A literal run; a backslash outside a string is junk like
+                // any other byte
+                size_t end = at + 1;
+                while (end < s->len && !(byte_class[(unsigned char)s->buf[end]] & ~C_BACKSLASH)) end++;
+                s->run_pos = at;
+                s->run_end = end;
+                s->pos = at;
+                break;
+            }
+        }
+    }
+}
+
+// Brackets are counted and each quote's closing offset is stepped over;
+// nothing else in the group is looked at
+void structural_skip_group(void *scanner) {
+    Structural *s = scanner;
+    int depth = 1;
+    size_t at, end;
+    while (next_index(s, &at)) {
+        switch (s->buf[at]) {
+            case '"':
+                if (!next_index(s, &end)) {
+                    s->pos = s->len;
+                    return;
+                }
+                break;
+            case '{':
+            case '[':
+                depth++;
+                break;
+            case '}':
+            case ']':
+                if (--depth == 0) {
+                    s->pos = at + 1;
+                    return;
+                }
+                break;
+        }
+    }
+    s->pos = s->len;
+}
+
+static Structural *new_structural(void) {
+    pthread_once(&kernel_once, pick_kernel);
+    Structural *s = calloc(1, sizeof(Structural));
+    if (s) {
+        s->index = malloc(INDEX_WINDOW * sizeof(uint32_t));
+        s->unclosed = SIZE_MAX;
+    }
+    if (s && !s->index) {
+        free(s);
+        return NULL;
+    }
+    return s;
+}
+
+// Read the whole file, for inputs that can't be mapped (pipes, /dev/stdin)
+static char *read_all(FILE *file, size_t *len) {
+    size_t cap = 1 << 16, used = 0;
+    char *buf = malloc(cap);
+    size_t n;
+    while (buf && (n = fread(buf + used, 1, cap - used, file)) > 0) {
+        used += n;
+        if (used == cap) {
+            cap *= 2;
+            char *grown = realloc(buf, cap);
+            if (!grown) free(buf);
+            buf = grown;
+        }
+    }
+    *len = used;
+    return buf;
+}
+
+void *structural_open(const char *filename) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return NULL;
+    Structural *s = new_structural();
+    if (!s) {
+        close(fd);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void *mapped = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped != MAP_FAILED) {
+            madvise(mapped, st.st_size, MADV_SEQUENTIAL);
+            s->mapped = mapped;
+            s->mapped_len = st.st_size;
+            s->buf = mapped;
+            s->len = st.st_size;
+            close(fd);
+            return s;
+        }
+    }
+
+    FILE *file = fdopen(fd, "r");
+    if (file) s->owned = read_all(file, &s->len);
+    if (file) fclose(file);
+    else close(fd);
+    if (!s->owned) {
+        structural_close(s);
+        return NULL;
+    }
+    s->buf = s->owned;
+    return s;
+}
+
+void structural_close(void *scanner) {
+    Structural *s = scanner;
+    if (s->mapped) munmap(s->mapped, s->mapped_len);
+    free(s->owned);
+    free(s->index);
+    free(s);
+}
+
+// Only needed for error messages, so the position is worked out from the
+// start of the input: the flex scanner starts a new line on a newline
+// between tokens, and counts one column per byte otherwise, strings included
+static void position(Structural *s, int *line, int *column) {
+    int in_string = 0, escaped = 0;
+    *line = 1;
+    *column = 1;
+    for (size_t i = 0; i < s->pos && i < s->len; i++) {
+        char c = s->buf[i];
+        if (in_string) {
+            if (escaped) escaped = 0;
+            else if (c == '\\') escaped = 1;
+            else if (c == '"') in_string = 0;
+            (*column)++;
+        } else if (c == '\n') {
+            (*line)++;
+            *column = 1;
+        } else {
+            if (c == '"' && i != s->unclosed) in_string = 1;
+            (*column)++;
+        }
+    }
+}
+
+int structural_line(void *scanner) {
+    int line, column;
+    position(scanner, &line, &column);
+    return line;
+}
+
+int structural_column(void *scanner) {
+    int line, column;
+    position(scanner, &line, &column);
+    return column;
+}
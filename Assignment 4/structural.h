@@ -0,0 +1,37 @@
+#ifndef STRUCTURAL_H
+#define STRUCTURAL_H
+
+#include <stddef.h>
+#include "parser.h"
+
+// --scanner=simd: a front end that finds quotes, backslashes, brackets,
+// colons, commas and the starts of literals 64 bytes at a time (AVX2 or SSE2,
+// picked at run time, with a plain C fallback) and then hands out the same
+// tokens as the flex scanner by walking that structural index. Valid JSON
+// gives identical tokens on both paths.
+
+// The file is mapped read-only, or read whole if it can't be mapped.
+// Returns NULL if the file can't be opened.
+void *structural_open(const char *filename);
+void structural_close(void *scanner);
+
+// Next token, as yylex(): its value goes in lval, 0 at the end of input
+int structural_lex(YYSTYPE *lval, void *scanner);
+
+// --select/--exclude: skip the rest of an object or array whose opening
+// bracket was the last token, up to and including its closing bracket.
+// Only brackets and quotes are looked at, so what is inside isn't checked.
+void structural_skip_group(void *scanner);
+
+// Position after the last token, counted as the flex scanner counts it
+int structural_line(void *scanner);
+int structural_column(void *scanner);
+
+// Which block classifier is in use: "avx2", "sse2" or "scalar". The best one
+// the CPU supports is picked; structural_set_kernel() switches, for
+// benchmarks, and returns -1 if the CPU can't run it. Not for use while
+// scanners are open on other threads.
+const char *structural_kernel(void);
+int structural_set_kernel(const char *name);
+
+#endif